@@ -1,14 +1,34 @@
 #include <blaze/math/DynamicMatrix.h>
 #include <celero/Celero.h>
+#include "image/edt.h"
 #include "image/filter.h"
+#include "image/histogram.h"
+#include "image/integral.h"
+#include "image/lut.h"
 #include "image/morph.h"
+#include "image/pipeline.h"
+#include "image/view.h"
+#include "parallel.h"
 
 auto rand_img =
   blaze::Rand<blaze::DynamicMatrix<uint8_t, blaze::rowMajor>>().generate(1920,
                                                                          1080);
 
+auto rand_img_4k =
+  blaze::Rand<blaze::DynamicMatrix<uint8_t, blaze::rowMajor>>().generate(3840,
+                                                                         2160);
+
+balken::parallel::ThreadPool pool;
+
 auto kernel = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(5, 5, 1);
 
+auto kernel_15 = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(15, 15, 1);
+auto kernel_31 = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(31, 31, 1);
+
+auto cross = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+  {0, 0, 1, 0, 0}, {0, 0, 1, 0, 0}, {1, 1, 1, 1, 1}, {0, 0, 1, 0, 0},
+  {0, 0, 1, 0, 0}};
+
 
 CELERO_MAIN
 
@@ -21,11 +41,117 @@ BENCHMARK(BenchmarkFilters, dilate_view, 1, 1) {
   celero::DoNotOptimizeAway(balken::morph::erode(res, kernel));
 }
 
-// BENCHMARK(BenchmarkFilters, sobel, 100, 10) {
-//   celero::DoNotOptimizeAway(
-//     balken::filter::convolve(rand_img, balken::filter::detail::sobel_x));
-// }
-//
+BENCHMARK(BenchmarkFilters, dilate_view_materialize, 1, 1) {
+  celero::DoNotOptimizeAway(
+    balken::morph::views::dilate(rand_img, kernel).materialize());
+}
+BENCHMARK(BenchmarkFilters, dilate_view_4k, 1, 1) {
+  auto res = balken::morph::views::dilate(rand_img_4k, kernel);
+  for (size_t i = 0; i < res.rows(); ++i) {
+    for (size_t j = 0; j < res.columns(); ++j) {
+      celero::DoNotOptimizeAway(res(i, j));
+    }
+  }
+}
+BENCHMARK(BenchmarkFilters, dilate_view_materialize_4k, 1, 1) {
+  celero::DoNotOptimizeAway(
+    balken::morph::views::dilate(rand_img_4k, kernel).materialize());
+}
+
+BENCHMARK(BenchmarkFilters, erode_dilate_view_tiled_4k, 1, 1) {
+  using namespace balken::morph::adaptors;
+  auto out = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(
+    rand_img_4k.rows(), rand_img_4k.columns());
+  balken::view::materialize(
+    rand_img_4k | erode(cross) | dilate(cross), out, pool);
+  celero::DoNotOptimizeAway(out);
+}
+
+BENCHMARK(BenchmarkFilters, close_view, 1, 1) {
+  using namespace balken::morph::adaptors;
+  auto res = rand_img | dilate(cross) | erode(cross);
+  for (size_t i = 0; i < res.rows(); ++i) {
+    for (size_t j = 0; j < res.columns(); ++j) {
+      celero::DoNotOptimizeAway(res(i, j));
+    }
+  }
+}
+
+BENCHMARK(BenchmarkFilters, histogram_4k, 1, 1) {
+  celero::DoNotOptimizeAway(balken::histogram::count(rand_img_4k));
+}
+BENCHMARK(BenchmarkFilters, histogram_4k_parallel, 1, 1) {
+  celero::DoNotOptimizeAway(balken::histogram::count(rand_img_4k, pool));
+}
+
+BENCHMARK(BenchmarkFilters, stretch_binarize_4k, 1, 1) {
+  auto out = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(
+    rand_img_4k.rows(), rand_img_4k.columns());
+  balken::view::materialize(
+    balken::filter::views::binarize(
+      balken::histogram::views::stretch(rand_img_4k), 150),
+    out);
+  celero::DoNotOptimizeAway(out);
+}
+
+BASELINE(BenchmarkLut, lut_scalar_4k, 1, 1) {
+  const auto lut = balken::lut::threshold(150);
+  for (size_t i = 0; i < rand_img_4k.rows(); ++i) {
+    auto row = &rand_img_4k(i, 0);
+    balken::simd::detail::lut_scalar(
+      lut.data(), row, row, rand_img_4k.columns());
+  }
+  celero::DoNotOptimizeAway(rand_img_4k);
+}
+BENCHMARK(BenchmarkLut, lut_transform_4k, 1, 1) {
+  celero::DoNotOptimizeAway(
+    balken::lut::transform(rand_img_4k, balken::lut::threshold(150)));
+}
+
+BENCHMARK(BenchmarkFilters, box_7_4k, 1, 1) {
+  celero::DoNotOptimizeAway(balken::integral::box(rand_img_4k, 7));
+}
+
+BENCHMARK(BenchmarkFilters, edt_4k, 1, 1) {
+  celero::DoNotOptimizeAway(balken::edt::transform(
+    rand_img_4k, balken::edt::Metric::euclidean));
+}
+BENCHMARK(BenchmarkFilters, edt_4k_parallel, 1, 1) {
+  celero::DoNotOptimizeAway(balken::edt::transform(
+    rand_img_4k, balken::edt::Metric::euclidean, pool));
+}
+
+BENCHMARK(BenchmarkFilters, bottom_hat, 1, 1) {
+  auto closed = balken::morph::close(
+    balken::histogram::views::stretch(rand_img), kernel_15);
+  decltype(rand_img) bottom_hat = closed - rand_img;
+  celero::DoNotOptimizeAway(balken::morph::dilate(
+    balken::filter::views::binarize(bottom_hat, 40), kernel));
+}
+BENCHMARK(BenchmarkFilters, bottom_hat_fused, 1, 1) {
+  auto detect = balken::pipeline::BottomHat(15, 15, 40, 5, 5);
+  celero::DoNotOptimizeAway(detect(rand_img));
+}
+
+BENCHMARK(BenchmarkFilters, close_rect_15, 1, 1) {
+  celero::DoNotOptimizeAway(balken::morph::close(rand_img, kernel_15));
+}
+BENCHMARK(BenchmarkFilters, close_rect_31, 1, 1) {
+  celero::DoNotOptimizeAway(balken::morph::close(rand_img, kernel_31));
+}
+
+BENCHMARK(BenchmarkFilters, sobel_float, 1, 1) {
+  celero::DoNotOptimizeAway(
+    balken::filter::convolve_float(rand_img, balken::filter::detail::sobel_x));
+}
+BENCHMARK(BenchmarkFilters, sobel_separable, 1, 1) {
+  celero::DoNotOptimizeAway(
+    balken::filter::convolve(rand_img, balken::filter::detail::sobel_x));
+}
+BENCHMARK(BenchmarkFilters, gauss_separable, 1, 1) {
+  celero::DoNotOptimizeAway(balken::filter::gauss(rand_img));
+}
+
 // BENCHMARK(BenchmarkFilters, erode, 100, 10) {
 //   celero::DoNotOptimizeAway(balken::filter::erode(rand_img, kernel));
 // }
@@ -15,12 +15,15 @@
 #include <blaze/math/Submatrix.h>
 
 // own
+#include "arena.h"
 #include "datamatrix.h"
+#include "finder.h"
 #include "image/edt.h"
 #include "image/filter.h"
 #include "image/geometry.h"
 #include "image/histogram.h"
 #include "image/morph.h"
+#include "image/pipeline.h"
 #include "region/draw.h"
 #include "region/regions.h"
 #include "util.h"
@@ -34,10 +37,6 @@ int main(int, char * argv[]) {
   int         SE2       = atoi(argv[4]);
   int         SE3       = atoi(argv[5]);
 
-  auto se1 = blaze::DynamicMatrix<uint8_t>(
-    static_cast<size_t>(SE1), static_cast<size_t>(SE1), 1);
-  auto se2 = blaze::DynamicMatrix<uint8_t>(
-    static_cast<size_t>(SE2), static_cast<size_t>(SE2), 1);
   auto se3 = blaze::DynamicMatrix<uint8_t>(
     static_cast<size_t>(SE3), static_cast<size_t>(SE3), 1);
 
@@ -45,33 +44,62 @@ int main(int, char * argv[]) {
   auto cpy = img;
   util::view_image(cpy);
 
-  auto closed = morph::close(histogram::views::stretch(img), se1);
-  util::view_image(closed);
-  decltype(img) bottom_hat = closed - img;
-  util::view_image(bottom_hat);
-  auto binarized = filter::views::binarize(bottom_hat, threshold);
-  util::view_image(binarized);
-  auto dilated    = morph::views::dilate(binarized, se2);
-  auto region_vec = regions::find(dilated);
-  std::cout << "Size before: " << region_vec.size() << '\n';
-  regions::filter(img.rows() * img.columns(), region_vec);
-  std::cout << "Size after: " << region_vec.size() << '\n';
+  // stretch -> close -> bottom-hat -> binarize -> dilate in a single pass
+  auto detect     = pipeline::BottomHat(static_cast<size_t>(SE1),
+                                        static_cast<size_t>(SE1),
+                                        threshold,
+                                        static_cast<size_t>(SE2),
+                                        static_cast<size_t>(SE2));
+
+  // Intermediates of the frame, reset() before the next one
+  arena::FrameArena frame;
+  auto              dilated = frame.matrix<uint8_t>(img.rows(), img.columns());
+  detect(img, dilated);
+
+  auto labeling = regions::Labeling();
+  regions::label(dilated, labeling, frame);
+  std::cout << "Size before: " << labeling.size() << '\n';
+  const auto size       = img.rows() * img.columns();
+  auto       candidates = regions::Selection()
+                      .area(size / 50, size / 10)
+                      .solidity(0.5)(labeling);
+  std::cout << "Size after: " << candidates.size() << '\n';
   util::view_image(dilated);
 
-  auto region = region_vec[1];
   auto hull_img =
-    blaze::DynamicMatrix<uint8_t>(dilated.rows(), dilated.columns(), 0);
+    frame.matrix<uint8_t>(dilated.rows(), dilated.columns(), uint8_t{0});
 
-  auto hull = regions::convex_hull(region);
+  auto hull = regions::convex_hull(labeling, candidates[1]);
   draw::draw_shape(hull_img, hull, 255UL);
   auto bounding_box = regions::bounding_box(hull);
   util::view_image(hull_img);
 
-  auto sub = blaze::submatrix(img,
-                              bounding_box[0].i,
-                              bounding_box[0].j,
-                              bounding_box[3].i - bounding_box[0].i,
-                              bounding_box[1].j - bounding_box[0].j);
+  // Finder pattern and timing border give orientation and symbol size
+  auto find     = finder::Finder();
+  auto location = find(img, regions::minimal_bounding_rectangle(hull));
+  if (location) {
+    auto modules = datamatrix::sample(img,
+                                      location.corners,
+                                      location.symbol->rows,
+                                      location.symbol->columns);
+    auto payload = datamatrix::decode(modules);
+    std::cout << "Finder: " << std::string(payload.begin(), payload.end())
+              << '\n';
+  }
+
+  const auto roi_row     = static_cast<size_t>(bounding_box[0].i);
+  const auto roi_column  = static_cast<size_t>(bounding_box[0].j);
+  const auto roi_rows    = static_cast<size_t>(bounding_box[3].i) - roi_row;
+  const auto roi_columns = static_cast<size_t>(bounding_box[1].j) - roi_column;
+
+  // libdmtx reads the candidate region in place
+  auto decoder = datamatrix::DmtxDecoder();
+  auto payload = decoder(img, roi_row, roi_column, roi_rows, roi_columns);
+  std::cout << "Payload: " << std::string(payload.begin(), payload.end())
+            << '\n';
+
+  auto sub =
+    blaze::submatrix(img, roi_row, roi_column, roi_rows, roi_columns);
 
   auto matrix = datamatrix::code(
     filter::views::binarize(histogram::views::stretch(sub), 150));
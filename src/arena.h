@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__ARENA_H__INCLUDED
+#define BALKEN__ARENA_H__INCLUDED
+
+// cpp
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// external
+#include <blaze/math/CustomMatrix.h>
+
+namespace balken {
+namespace arena {
+
+/**
+ * Row-major matrix on memory owned by a FrameArena
+ */
+template <class T>
+using Matrix =
+  blaze::CustomMatrix<T, blaze::unaligned, blaze::unpadded, blaze::rowMajor>;
+
+/**
+ * Bump allocator for the intermediates of one frame.
+ *
+ * Allocations are carved out of large blocks and never freed individually,
+ * reset() releases everything at once between frames. If a frame needed
+ * more than one block, reset() replaces them by a single block of the
+ * combined size, so a steady stream of equally sized frames allocates
+ * nothing after the first one. Not thread safe, use one arena per thread.
+ */
+class FrameArena
+{
+  struct Block
+  {
+    std::unique_ptr<unsigned char[]> data;
+    std::size_t                      size;
+  };
+
+public:
+  // Allocations are aligned for SIMD loads
+  static constexpr std::size_t alignment = 64;
+
+public:
+  explicit FrameArena(std::size_t capacity = 0) {
+    if (capacity > 0) { add_block(capacity); }
+  }
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena(FrameArena &&)      = default;
+  FrameArena & operator=(const FrameArena &) = delete;
+  FrameArena & operator=(FrameArena &&) = default;
+
+  /**
+   * \brief  Uninitialized storage for n elements, valid until reset()
+   */
+  template <class T>
+  T * allocate(std::size_t n) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "arena memory is released without running destructors");
+    return static_cast<T *>(allocate_bytes(n * sizeof(T)));
+  }
+
+  /**
+   * \brief  Uninitialized rows x columns matrix, valid until reset()
+   */
+  template <class T>
+  Matrix<T> matrix(std::size_t rows, std::size_t columns) {
+    return Matrix<T>(allocate<T>(rows * columns), rows, columns);
+  }
+
+  template <class T>
+  Matrix<T> matrix(std::size_t rows, std::size_t columns, T value) {
+    T * data = allocate<T>(rows * columns);
+    std::fill_n(data, rows * columns, value);
+    return Matrix<T>(data, rows, columns);
+  }
+
+  /**
+   * \brief  Release all allocations of the current frame
+   */
+  void reset() {
+    if (_blocks.size() > 1) {
+      const std::size_t size = capacity();
+      _blocks.clear();
+      add_block(size);
+    }
+    _block  = 0;
+    _offset = 0;
+    _used   = 0;
+  }
+
+  // Bytes handed out since the last reset
+  std::size_t used() const { return _used; }
+
+  // Bytes held in blocks
+  std::size_t capacity() const {
+    std::size_t ret = 0;
+    for (const auto & block : _blocks) { ret += block.size; }
+    return ret;
+  }
+
+private:
+  void * allocate_bytes(std::size_t bytes) {
+    while (_block < _blocks.size()) {
+      auto &     block = _blocks[_block];
+      const auto base  = reinterpret_cast<std::uintptr_t>(block.data.get());
+      const auto begin =
+        (base + _offset + alignment - 1) & ~std::uintptr_t{alignment - 1};
+      if (begin + bytes <= base + block.size) {
+        _offset = begin + bytes - base;
+        _used += bytes;
+        return reinterpret_cast<void *>(begin);
+      }
+      ++_block;
+      _offset = 0;
+    }
+
+    // Grow geometrically, with room for the alignment of the first element
+    add_block(
+      std::max({bytes + alignment, 2 * capacity(), std::size_t{min_block}}));
+    return allocate_bytes(bytes);
+  }
+
+  void add_block(std::size_t size) {
+    _blocks.push_back(Block{std::unique_ptr<unsigned char[]>(
+                              new unsigned char[size]),
+                            size});
+  }
+
+private:
+  static constexpr std::size_t min_block = 1 << 16;
+
+  std::vector<Block> _blocks;
+  std::size_t        _block{0};
+  std::size_t        _offset{0};
+  std::size_t        _used{0};
+};
+
+/**
+ * Standard allocator drawing from a FrameArena, deallocation is a no-op
+ */
+template <class T>
+class Allocator
+{
+public:
+  using value_type = T;
+
+public:
+  explicit Allocator(FrameArena & arena) : _arena{&arena} {}
+
+  template <class U>
+  Allocator(const Allocator<U> & other) : _arena{other.arena()} {}
+
+  T * allocate(std::size_t n) { return _arena->allocate<T>(n); }
+  void deallocate(T *, std::size_t) {}
+
+  FrameArena * arena() const { return _arena; }
+
+private:
+  FrameArena * _arena;
+};
+
+template <class T, class U>
+bool operator==(const Allocator<T> & a, const Allocator<U> & b) {
+  return a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(const Allocator<T> & a, const Allocator<U> & b) {
+  return !(a == b);
+}
+
+/**
+ * Vector on memory owned by a FrameArena
+ */
+template <class T>
+using Vector = std::vector<T, Allocator<T>>;
+
+}  // namespace arena
+}  // namespace balken
+
+#endif
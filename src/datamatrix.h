@@ -10,20 +10,27 @@
 #define BALKEN__DATAMATRIX_H__INCLUDED
 
 // cpp
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 // external
 #include <blaze/math/DynamicMatrix.h>
 #include <dmtx.h>
 
 // own
+#include "ecc200.h"
+#include "image/geometry.h"
 #include "types.h"
 #include "util.h"
 
-#define DEBUG (1)
-
 namespace balken {
 namespace datamatrix {
 namespace detail {
@@ -319,127 +326,217 @@ auto code(const ImageT & img) {
   return inner_mat;
 }
 
+/**
+ * \brief  Bitmap of a datamatrix code in a greyscale image
+ *
+ * Modules are sampled through the homography of the unit square onto the
+ * corners, see geometry::sample, and thresholded halfway between the darkest
+ * and the brightest module. Dark modules are 1.
+ *
+ * \param[in]  img      Greyscale image
+ * \param[in]  corners  Outer corners of the symbol in order around it,
+ *                      starting at the corner of the top left module
+ * \param[in]  rows     Number of module rows of the symbol
+ * \param[in]  columns  Number of module columns of the symbol
+ */
+template <class ImageT>
+blaze::DynamicMatrix<uint8_t> sample(const ImageT &               img,
+                                     const std::array<Point, 4> & corners,
+                                     std::size_t                  rows,
+                                     std::size_t                  columns) {
+  auto ret = geometry::sample(img, corners, rows, columns);
+  if (ret.rows() == 0 || ret.columns() == 0) { return ret; }
+
+  uint8_t min = 255;
+  uint8_t max = 0;
+  for (std::size_t i = 0; i < ret.rows(); ++i) {
+    for (std::size_t j = 0; j < ret.columns(); ++j) {
+      min = std::min(min, ret(i, j));
+      max = std::max(max, ret(i, j));
+    }
+  }
+
+  const int threshold = (min + max + 1) / 2;
+  for (std::size_t i = 0; i < ret.rows(); ++i) {
+    for (std::size_t j = 0; j < ret.columns(); ++j) {
+      ret(i, j) = ret(i, j) < threshold ? 1 : 0;
+    }
+  }
+  return ret;
+}
+
+template <class ImageT>
+blaze::DynamicMatrix<uint8_t> sample(const ImageT &    img,
+                                     const Rectangle & rectangle,
+                                     std::size_t       rows,
+                                     std::size_t       columns) {
+  return sample(img, rectangle.points, rows, columns);
+}
+
 /**
  * Decode a datamatrix code and return a vector of bytes of the matrices
  * content.
  *
- * \param[in] code  Bitmap of a datamatrix code
+ * Codewords are gathered through the placement table of the symbol size,
+ * corrected with its Reed-Solomon blocks and decoded into bytes.
+ *
+ * \param[in] code  Bitmap of a datamatrix code, one element per module
  *
- * \return  vector of bytes of matrix content
+ * \return  vector of bytes of matrix content, empty if decoding failed
  */
 template <class CodeT>
 std::vector<uint8_t> decode(const CodeT & code) {
-  // Fix coordinates of codeword #1
   auto res = std::vector<uint8_t>();
 
-  auto column = 0;
-  auto row    = 4;
-
-  auto inner =
-    blaze::submatrix(code, 1UL, 1UL, code.rows() - 2, code.columns() - 2);
-
-  // #ifdef DEBUG
-  //   std::cout << "(" << column << ", " << row
-  //             << ") = " << static_cast<int>(res.back()) << std::endl;
-  // #endif
-
-  while (row < static_cast<int>(inner.rows()) ||
-         column < static_cast<int>(inner.columns())) {
-    if (row == static_cast<int>(inner.rows() - 2) && column == 0) {
-      res.push_back(detail::decode_codeword(Point(row, column), inner));
-    } else if ((row == static_cast<int>(inner.rows() - 2)) and
-               (column == 0) and (inner.columns() % 4)) {
-      res.push_back(detail::decode_codeword(Point(row, column), inner));
-
-    } else if ((row == static_cast<int>(inner.rows() - 2)) and
-               (column == 0) and ((inner.columns() % 8) == 4)) {
-      res.push_back(detail::decode_codeword(Point(row, column), inner));
-    } else if ((row == static_cast<int>(inner.rows() + 4)) and
-               (column == 2) and !(inner.columns() % 8)) {
-      res.push_back(detail::decode_codeword(Point(row, column), inner));
-    }
-
-    while ((row >= 0) && column < static_cast<int>(inner.columns())) {
-      res.push_back(detail::decode_codeword(Point(row, column), inner));
-      row -= 2;
-      column += 2;
-#ifdef DEBUG
-      std::cout << "(" << column << ", " << row
-                << ") = " << static_cast<int>(res.back()) << std::endl;
-#endif
-    }
-    row += 1;
-    column += 3;
-
-#ifdef DEBUG
-    std::cout << "(" << column << ", " << row
-              << ") = " << static_cast<int>(res.back()) << std::endl;
-#endif
+  const auto * symbol = ecc200::find(code.rows(), code.columns());
+  if (symbol == nullptr) { return res; }
 
-    while ((column >= 0) and row < static_cast<int>(inner.rows())) {
-      res.push_back(detail::decode_codeword(Point(row, column), inner));
-      row += 2;
-      column -= 2;
-#ifdef DEBUG
-      std::cout << "(" << column << ", " << row
-                << ") = " << static_cast<int>(res.back()) << std::endl;
-#endif
-    }
-    row += 3;
-    column += 1;
-#ifdef DEBUG
-    std::cout << "(" << column << ", " << row
-              << ") = " << static_cast<int>(res.back()) << std::endl;
-#endif
+  auto codewords = std::array<uint8_t, ecc200::max_codewords>();
+  ecc200::gather(code, *symbol, codewords.data());
+  if (!ecc200::correct(*symbol, codewords.data())) { return res; }
+  if (!ecc200::decode_data(codewords.data(), symbol->data, res)) {
+    res.clear();
   }
-
   return res;
 }
 
-template <class CodeT>
-int dmtx_decode(const CodeT & code) {
-  auto _data = std::vector<uint8_t>();
-  for (size_t i = 0; i < code.rows(); ++i) {
-    for (size_t j = 0; j < code.columns(); ++j) {
-      _data.push_back(code(i, j));
-    }
+/**
+ * Decoder session around libdmtx
+ *
+ * The libdmtx image and decoder are kept alive between calls and only
+ * recreated when the size of the region of interest changes. Pixels are
+ * read in place from the row buffer of the image, including the padding
+ * blaze adds to each row, nothing is copied.
+ */
+class DmtxDecoder
+{
+  struct ImageDeleter
+  {
+    void operator()(DmtxImage * img) const { dmtxImageDestroy(&img); }
+  };
+
+  struct DecodeDeleter
+  {
+    void operator()(DmtxDecode * dec) const { dmtxDecodeDestroy(&dec); }
+  };
+
+public:
+  using Image = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>;
+
+public:
+  /**
+   * \param[in]  timeout  Time limit of the region search in milliseconds,
+   *                      0 searches the whole region of interest
+   */
+  explicit DmtxDecoder(long timeout = 0) : _timeout{timeout} {}
+
+  /**
+   * \brief  Decode the first symbol found in img
+   *
+   * \return  Decoded bytes, empty if no symbol was found
+   */
+  std::vector<uint8_t> operator()(const Image & img) {
+    return (*this)(img, 0, 0, img.rows(), img.columns());
   }
 
-  for (size_t i = 0; i < code.rows(); ++i) {
-    for (size_t j = 0; j < code.columns(); ++j) {
-      std::cout << static_cast<int>(_data.data()[j + (i * j)] == 255 ? 1 : 0)
-                << ' ';
+  /**
+   * \brief  Decode the first symbol found in a region of interest of img
+   *
+   * The region is given like blaze::submatrix, only its pixels are searched.
+   *
+   * \return  Decoded bytes, empty if no symbol was found
+   */
+  std::vector<uint8_t> operator()(const Image & img,
+                                  std::size_t   row,
+                                  std::size_t   column,
+                                  std::size_t   rows,
+                                  std::size_t   columns) {
+    assert(row + rows <= img.rows());
+    assert(column + columns <= img.columns());
+
+    auto ret = std::vector<uint8_t>();
+    if (rows == 0 || columns == 0) { return ret; }
+
+    // libdmtx only reads the pixels of an image it decodes
+    auto * pixels =
+      const_cast<uint8_t *>(img.data()) + row * img.spacing() + column;
+    prepare(pixels, rows, columns, img.spacing() - columns);
+
+    DmtxTime   deadline;
+    DmtxTime * timeout = nullptr;
+    if (_timeout > 0) {
+      deadline = dmtxTimeAdd(dmtxTimeNow(), _timeout);
+      timeout  = &deadline;
     }
-    std::cout << '\n';
-  }
 
-  DmtxImage * img =
-    dmtxImageCreate(_data.data(), code.columns(), code.rows(), DmtxPack8bppK);
-  assert(img != NULL);
+    DmtxRegion * reg = dmtxRegionFindNext(_dec.get(), timeout);
+    if (reg == nullptr) { return ret; }
 
-  DmtxDecode * dec = dmtxDecodeCreate(img, 1);
-  assert(dec != NULL);
-
-  DmtxRegion * reg = dmtxRegionFindNext(dec, NULL);
-  std::cout << "Looking for region" << '\n';
-
-  DmtxMessage * msg;
-  if (reg != NULL) {
-    std::cout << "Found region" << '\n';
-    msg = dmtxDecodeMatrixRegion(dec, reg, DmtxUndefined);
-    if (msg != NULL) {
-      for (size_t i = 0; i < static_cast<size_t>(msg->outputIdx); ++i) {
-        std::cout << msg->output[i];
-      }
-      std::cout << '\n';
+    DmtxMessage * msg = dmtxDecodeMatrixRegion(_dec.get(), reg, DmtxUndefined);
+    if (msg != nullptr) {
+      ret.assign(msg->output, msg->output + msg->outputIdx);
       dmtxMessageDestroy(&msg);
     }
     dmtxRegionDestroy(&reg);
+    return ret;
   }
-  dmtxDecodeDestroy(&dec);
-  dmtxImageDestroy(&img);
 
-  return 0;
+private:
+  /**
+   * Point the handles to the pixels of the next region of interest
+   */
+  void prepare(uint8_t *   pixels,
+               std::size_t rows,
+               std::size_t columns,
+               std::size_t padding) {
+    if (_img && rows == _rows && columns == _columns && padding == _padding) {
+      // Same geometry, forget the pixels visited by previous searches and
+      // restart the scan grid
+      _img->pxl = pixels;
+      std::fill_n(_dec->cache, rows * columns, 0);
+      dmtxDecodeSetProp(_dec.get(), DmtxPropXmin, 0);
+      return;
+    }
+
+    _dec.reset();
+    _img.reset(dmtxImageCreate(pixels,
+                               static_cast<int>(columns),
+                               static_cast<int>(rows),
+                               DmtxPack8bppK));
+    assert(_img != nullptr);
+    dmtxImageSetProp(
+      _img.get(), DmtxPropRowPadBytes, static_cast<int>(padding));
+
+    _dec.reset(dmtxDecodeCreate(_img.get(), 1));
+    assert(_dec != nullptr);
+
+    _rows    = rows;
+    _columns = columns;
+    _padding = padding;
+  }
+
+private:
+  long _timeout;
+
+  // The decoder refers to the image and is destroyed first
+  std::unique_ptr<DmtxImage, ImageDeleter>   _img;
+  std::unique_ptr<DmtxDecode, DecodeDeleter> _dec;
+
+  std::size_t _rows{0};
+  std::size_t _columns{0};
+  std::size_t _padding{0};
+};
+
+/**
+ * \brief  Decode a datamatrix code with libdmtx
+ *
+ * \param[in] code  Greyscale or binary image of a datamatrix code
+ *
+ * \return  Decoded bytes, empty if no symbol was found
+ */
+inline std::vector<uint8_t> dmtx_decode(const DmtxDecoder::Image & code) {
+  auto decoder = DmtxDecoder();
+  return decoder(code);
 }
 
 }  // namespace datamatrix
@@ -0,0 +1,655 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__ECC200_H__INCLUDED
+#define BALKEN__ECC200_H__INCLUDED
+
+// cpp
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace balken {
+namespace ecc200 {
+
+/**
+ * Attributes of an ECC200 symbol size
+ */
+struct Symbol
+{
+  // Size in modules, including finder and timing pattern
+  uint8_t rows;
+  uint8_t columns;
+  // Size of a single data region in modules
+  uint8_t region_rows;
+  uint8_t region_columns;
+  // Number of codewords
+  uint16_t data;
+  uint16_t ecc;
+  // Number of interleaved Reed-Solomon blocks
+  uint8_t blocks;
+};
+
+/**
+ * All ECC200 symbol sizes, square ones first
+ */
+constexpr Symbol symbols[] = {
+  {10, 10, 8, 8, 3, 5, 1},          {12, 12, 10, 10, 5, 7, 1},
+  {14, 14, 12, 12, 8, 10, 1},       {16, 16, 14, 14, 12, 12, 1},
+  {18, 18, 16, 16, 18, 14, 1},      {20, 20, 18, 18, 22, 18, 1},
+  {22, 22, 20, 20, 30, 20, 1},      {24, 24, 22, 22, 36, 24, 1},
+  {26, 26, 24, 24, 44, 28, 1},      {32, 32, 14, 14, 62, 36, 1},
+  {36, 36, 16, 16, 86, 42, 1},      {40, 40, 18, 18, 114, 48, 1},
+  {44, 44, 20, 20, 144, 56, 1},     {48, 48, 22, 22, 174, 68, 1},
+  {52, 52, 24, 24, 204, 84, 2},     {64, 64, 14, 14, 280, 112, 2},
+  {72, 72, 16, 16, 368, 144, 4},    {80, 80, 18, 18, 456, 192, 4},
+  {88, 88, 20, 20, 576, 224, 4},    {96, 96, 22, 22, 696, 272, 4},
+  {104, 104, 24, 24, 816, 336, 6},  {120, 120, 18, 18, 1050, 408, 6},
+  {132, 132, 20, 20, 1304, 496, 8}, {144, 144, 22, 22, 1558, 620, 10},
+  {8, 18, 6, 16, 5, 7, 1},          {8, 32, 6, 14, 10, 11, 1},
+  {12, 26, 10, 24, 16, 14, 1},      {12, 36, 10, 16, 22, 18, 1},
+  {16, 36, 14, 16, 32, 24, 1},      {16, 48, 14, 22, 49, 28, 1},
+};
+
+// Upper bounds over all symbol sizes
+constexpr std::size_t max_codewords = 1558 + 620;
+constexpr std::size_t max_block_ecc = 68;
+
+/**
+ * \brief  Symbol of the given size in modules
+ *
+ * \return  Symbol attributes or nullptr if no such symbol exists
+ */
+inline const Symbol * find(std::size_t rows, std::size_t columns) {
+  for (const auto & symbol : symbols) {
+    if (symbol.rows == rows && symbol.columns == columns) { return &symbol; }
+  }
+  return nullptr;
+}
+
+/**
+ * Position of a codeword bit in symbol coordinates
+ */
+struct Module
+{
+  uint8_t row;
+  uint8_t column;
+};
+
+namespace detail {
+
+// Size of the mapping matrix, the data regions without the patterns
+constexpr int mapping_rows(const Symbol & s) {
+  return s.rows / (s.region_rows + 2) * s.region_rows;
+}
+
+constexpr int mapping_columns(const Symbol & s) {
+  return s.columns / (s.region_columns + 2) * s.region_columns;
+}
+
+/**
+ * Modules of all codewords of symbols[I], eight per codeword with the most
+ * significant bit first
+ */
+template <std::size_t I>
+struct PlacementTable
+{
+  Module modules[(symbols[I].data + symbols[I].ecc) * 8];
+};
+
+/**
+ * Placement algorithm of ISO/IEC 16022 Annex F for symbols[I], evaluated
+ * at compile time
+ */
+template <std::size_t I>
+class PlacementBuilder
+{
+  static constexpr int nrow = mapping_rows(symbols[I]);
+  static constexpr int ncol = mapping_columns(symbols[I]);
+
+public:
+  constexpr PlacementTable<I> build() {
+    int chr = 0;
+    int row = 4;
+    int col = 0;
+    do {
+      if (row == nrow && col == 0) { corner1(chr++); }
+      if (row == nrow - 2 && col == 0 && ncol % 4) { corner2(chr++); }
+      if (row == nrow - 2 && col == 0 && ncol % 8 == 4) { corner3(chr++); }
+      if (row == nrow + 4 && col == 2 && !(ncol % 8)) { corner4(chr++); }
+
+      // Sweep up and to the right
+      do {
+        if (row < nrow && col >= 0 && !_used[row * ncol + col]) {
+          utah(row, col, chr++);
+        }
+        row -= 2;
+        col += 2;
+      } while (row >= 0 && col < ncol);
+      row += 1;
+      col += 3;
+
+      // Sweep down and to the left
+      do {
+        if (row >= 0 && col < ncol && !_used[row * ncol + col]) {
+          utah(row, col, chr++);
+        }
+        row += 2;
+        col -= 2;
+      } while (row < nrow && col >= 0);
+      row += 3;
+      col += 1;
+    } while (row < nrow || col < ncol);
+    return _table;
+  }
+
+private:
+  constexpr void module(int row, int col, int chr, int bit) {
+    if (row < 0) {
+      row += nrow;
+      col += 4 - ((nrow + 4) % 8);
+    }
+    if (col < 0) {
+      col += ncol;
+      row += 4 - ((ncol + 4) % 8);
+    }
+    _used[row * ncol + col] = true;
+
+    // Skip the finder and timing patterns around each data region
+    auto & m  = _table.modules[chr * 8 + bit];
+    m.row     = static_cast<uint8_t>(row + 1 + 2 * (row / region_rows));
+    m.column  = static_cast<uint8_t>(col + 1 + 2 * (col / region_columns));
+  }
+
+  // Regular L-shaped codeword with its last bit at (row, col)
+  constexpr void utah(int row, int col, int chr) {
+    module(row - 2, col - 2, chr, 0);
+    module(row - 2, col - 1, chr, 1);
+    module(row - 1, col - 2, chr, 2);
+    module(row - 1, col - 1, chr, 3);
+    module(row - 1, col, chr, 4);
+    module(row, col - 2, chr, 5);
+    module(row, col - 1, chr, 6);
+    module(row, col, chr, 7);
+  }
+
+  constexpr void corner1(int chr) {
+    module(nrow - 1, 0, chr, 0);
+    module(nrow - 1, 1, chr, 1);
+    module(nrow - 1, 2, chr, 2);
+    module(0, ncol - 2, chr, 3);
+    module(0, ncol - 1, chr, 4);
+    module(1, ncol - 1, chr, 5);
+    module(2, ncol - 1, chr, 6);
+    module(3, ncol - 1, chr, 7);
+  }
+
+  constexpr void corner2(int chr) {
+    module(nrow - 3, 0, chr, 0);
+    module(nrow - 2, 0, chr, 1);
+    module(nrow - 1, 0, chr, 2);
+    module(0, ncol - 4, chr, 3);
+    module(0, ncol - 3, chr, 4);
+    module(0, ncol - 2, chr, 5);
+    module(0, ncol - 1, chr, 6);
+    module(1, ncol - 1, chr, 7);
+  }
+
+  constexpr void corner3(int chr) {
+    module(nrow - 3, 0, chr, 0);
+    module(nrow - 2, 0, chr, 1);
+    module(nrow - 1, 0, chr, 2);
+    module(0, ncol - 2, chr, 3);
+    module(0, ncol - 1, chr, 4);
+    module(1, ncol - 1, chr, 5);
+    module(2, ncol - 1, chr, 6);
+    module(3, ncol - 1, chr, 7);
+  }
+
+  constexpr void corner4(int chr) {
+    module(nrow - 1, 0, chr, 0);
+    module(nrow - 1, ncol - 1, chr, 1);
+    module(0, ncol - 3, chr, 2);
+    module(0, ncol - 2, chr, 3);
+    module(0, ncol - 1, chr, 4);
+    module(1, ncol - 3, chr, 5);
+    module(1, ncol - 2, chr, 6);
+    module(1, ncol - 1, chr, 7);
+  }
+
+private:
+  static constexpr int region_rows    = symbols[I].region_rows;
+  static constexpr int region_columns = symbols[I].region_columns;
+
+  PlacementTable<I> _table{};
+  bool              _used[nrow * ncol]{};
+};
+
+template <std::size_t I>
+struct Placement
+{
+  static constexpr PlacementTable<I> table = PlacementBuilder<I>().build();
+};
+
+template <std::size_t I>
+constexpr PlacementTable<I> Placement<I>::table;
+
+template <std::size_t... Is>
+constexpr std::array<const Module *, sizeof...(Is)> placement_tables(
+  std::index_sequence<Is...>) {
+  return {{Placement<Is>::table.modules...}};
+}
+
+}  // namespace detail
+
+/**
+ * \brief  Modules of all codewords of a symbol, eight per codeword with the
+ *         most significant bit first
+ *
+ * \param[in]  symbol  Element of symbols
+ */
+inline const Module * placement(const Symbol & symbol) {
+  static constexpr auto tables = detail::placement_tables(
+    std::make_index_sequence<std::extent<decltype(symbols)>::value>());
+  return tables[static_cast<std::size_t>(&symbol - symbols)];
+}
+
+/**
+ * \brief  Read the codewords of a symbol from its modules
+ *
+ * \param[in]   code       Modules of the whole symbol, nonzero is dark
+ * \param[in]   symbol     Symbol size of code
+ * \param[out]  codewords  symbol.data + symbol.ecc codewords
+ */
+template <class CodeT>
+void gather(const CodeT & code, const Symbol & symbol, uint8_t * codewords) {
+  const Module *    m = placement(symbol);
+  const std::size_t n = std::size_t{symbol.data} + symbol.ecc;
+  for (std::size_t k = 0; k < n; ++k, m += 8) {
+    unsigned v = 0;
+    for (std::size_t b = 0; b < 8; ++b) {
+      v = v << 1 | (code(m[b].row, m[b].column) != 0);
+    }
+    codewords[k] = static_cast<uint8_t>(v);
+  }
+}
+
+namespace detail {
+
+/**
+ * Exponent and logarithm tables of GF(256) with the ECC200 field polynomial
+ * x^8 + x^5 + x^3 + x^2 + 1. The exponent table is doubled, so products
+ * need no reduction modulo 255.
+ */
+struct GaloisTables
+{
+  uint8_t exp[512];
+  uint8_t log[256];
+};
+
+constexpr GaloisTables galois_tables() {
+  GaloisTables t{};
+  unsigned     x = 1;
+  for (unsigned i = 0; i < 255; ++i) {
+    t.exp[i]       = static_cast<uint8_t>(x);
+    t.exp[i + 255] = static_cast<uint8_t>(x);
+    t.log[x]       = static_cast<uint8_t>(i);
+    x <<= 1;
+    if (x & 0x100) { x ^= 0x12D; }
+  }
+  t.exp[510] = t.exp[0];
+  t.exp[511] = t.exp[1];
+  return t;
+}
+
+constexpr GaloisTables gf = galois_tables();
+
+inline uint8_t mul(uint8_t a, uint8_t b) {
+  return a && b ? gf.exp[gf.log[a] + gf.log[b]] : 0;
+}
+
+inline uint8_t div(uint8_t a, uint8_t b) {
+  assert(b != 0);
+  return a ? gf.exp[gf.log[a] + 255 - gf.log[b]] : 0;
+}
+
+// alpha^e
+inline uint8_t power(std::size_t e) { return gf.exp[e % 255]; }
+
+// Polynomial with coefficients p[0..degree], lowest first, at x
+inline uint8_t evaluate(const uint8_t * p, std::size_t degree, uint8_t x) {
+  uint8_t v = p[degree];
+  for (std::size_t j = degree; j-- > 0;) { v = mul(v, x) ^ p[j]; }
+  return v;
+}
+
+/**
+ * Value of a Base 256 codeword at the 1-based position pos of the data
+ * codewords, undoing the 255-state randomization
+ */
+inline uint8_t unrandomize(uint8_t codeword, std::size_t pos) {
+  const int r = static_cast<int>((149 * pos) % 255) + 1;
+  const int v = codeword - r;
+  return static_cast<uint8_t>(v >= 0 ? v : v + 256);
+}
+
+/**
+ * Decode C40 or Text triples starting at data[k] until an unlatch or the
+ * end of the data codewords
+ */
+inline bool decode_triples(const uint8_t *        data,
+                           std::size_t            n,
+                           std::size_t &          k,
+                           bool                   text,
+                           std::vector<uint8_t> & out) {
+  int  shift = 0;
+  bool upper = false;
+  auto put   = [&](int c) {
+    out.push_back(static_cast<uint8_t>(upper ? c + 128 : c));
+    upper = false;
+  };
+
+  while (k + 1 < n && data[k] != 254) {
+    // Three values below 40 each, pairs of 0 or above 64000 are invalid
+    const unsigned pair = data[k] * 256U + data[k + 1];
+    if (pair == 0 || pair - 1 >= 64000) { return false; }
+    const unsigned v = pair - 1;
+    k += 2;
+    const int values[3] = {static_cast<int>(v / 1600),
+                           static_cast<int>(v / 40 % 40),
+                           static_cast<int>(v % 40)};
+    for (const int c : values) {
+      switch (shift) {
+        case 0:
+          if (c < 3) {
+            shift = c + 1;
+            continue;
+          }
+          if (c == 3) {
+            put(' ');
+          } else if (c < 14) {
+            put('0' + c - 4);
+          } else {
+            put((text ? 'a' : 'A') + c - 14);
+          }
+          break;
+        case 1:
+          if (c > 31) { return false; }
+          put(c);
+          break;
+        case 2:
+          if (c < 15) {
+            put('!' + c);
+          } else if (c < 22) {
+            put(':' + c - 15);
+          } else if (c < 27) {
+            put('[' + c - 22);
+          } else if (c == 27) {
+            put(29);  // FNC1
+          } else if (c == 30) {
+            upper = true;
+          } else {
+            return false;
+          }
+          break;
+        default:
+          if (c > 31) { return false; }
+          if (!text) {
+            put(96 + c);
+          } else if (c == 0) {
+            put('`');
+          } else if (c < 27) {
+            put('A' + c - 1);
+          } else {
+            put('{' + c - 27);
+          }
+          break;
+      }
+      shift = 0;
+    }
+  }
+
+  // Unlatch, a single remaining codeword is ASCII encoded
+  if (k < n && data[k] == 254) { ++k; }
+  return true;
+}
+
+/**
+ * Decode a Base 256 field starting with its length at data[k]
+ */
+inline bool decode_base256(const uint8_t *        data,
+                           std::size_t            n,
+                           std::size_t &          k,
+                           std::vector<uint8_t> & out) {
+  if (k >= n) { return false; }
+  const std::size_t d1 = unrandomize(data[k], k + 1);
+  ++k;
+
+  std::size_t length = d1;
+  if (d1 == 0) {
+    // Field extends to the end of the symbol
+    length = n - k;
+  } else if (d1 > 249) {
+    if (k >= n) { return false; }
+    length = (d1 - 249) * 250 + unrandomize(data[k], k + 1);
+    ++k;
+  }
+  if (k + length > n) { return false; }
+
+  for (const auto end = k + length; k < end; ++k) {
+    out.push_back(unrandomize(data[k], k + 1));
+  }
+  return true;
+}
+
+}  // namespace detail
+
+/**
+ * \brief  Correct a single Reed-Solomon block in place
+ *
+ * Syndromes are computed for the generator roots alpha^1 .. alpha^nsym, the
+ * error locator by Berlekamp-Massey, its roots by a Chien search over the
+ * positions of the (shortened) block and the magnitudes by Forney's formula.
+ *
+ * \param[in,out]  block  Data codewords followed by nsym ECC codewords
+ * \param[in]      n      Length of the block, at most 255
+ * \param[in]      nsym   Number of ECC codewords
+ *
+ * \return  false if the block has more than nsym / 2 errors
+ */
+inline bool correct(uint8_t * block, std::size_t n, std::size_t nsym) {
+  assert(n <= 255 && nsym <= max_block_ecc && nsym < n);
+  using namespace detail;
+
+  uint8_t syndromes[max_block_ecc];
+  bool    errors = false;
+  for (std::size_t s = 0; s < nsym; ++s) {
+    const uint8_t x = power(s + 1);
+    uint8_t       v = 0;
+    for (std::size_t i = 0; i < n; ++i) { v = mul(v, x) ^ block[i]; }
+    syndromes[s] = v;
+    errors |= v != 0;
+  }
+  if (!errors) { return true; }
+
+  // Berlekamp-Massey, lambda is the error locator
+  uint8_t     lambda[max_block_ecc + 1] = {1};
+  uint8_t     prev[max_block_ecc + 1]   = {1};
+  uint8_t     tmp[max_block_ecc + 1];
+  std::size_t L = 0;
+  std::size_t m = 1;
+  uint8_t     b = 1;
+  for (std::size_t r = 0; r < nsym; ++r) {
+    uint8_t d = syndromes[r];
+    for (std::size_t i = 1; i <= L; ++i) {
+      d ^= mul(lambda[i], syndromes[r - i]);
+    }
+    if (d == 0) {
+      ++m;
+      continue;
+    }
+
+    const uint8_t coef   = div(d, b);
+    const bool    update = 2 * L <= r;
+    if (update) { std::copy_n(lambda, nsym + 1, tmp); }
+    for (std::size_t i = 0; i + m <= nsym; ++i) {
+      lambda[i + m] ^= mul(coef, prev[i]);
+    }
+    if (update) {
+      L = r + 1 - L;
+      std::copy_n(tmp, nsym + 1, prev);
+      b = d;
+      m = 1;
+    } else {
+      ++m;
+    }
+  }
+  if (2 * L > nsym) { return false; }
+
+  // Error evaluator omega = syndromes * lambda mod x^nsym
+  uint8_t omega[max_block_ecc];
+  for (std::size_t i = 0; i < nsym; ++i) {
+    uint8_t v = 0;
+    for (std::size_t j = 0; j <= std::min(i, L); ++j) {
+      v ^= mul(lambda[j], syndromes[i - j]);
+    }
+    omega[i] = v;
+  }
+
+  // Chien search, the codeword of degree p is located by alpha^p
+  std::size_t found = 0;
+  for (std::size_t p = 0; p < n && found < L; ++p) {
+    const uint8_t x_inv = power(255 - p % 255);
+    if (evaluate(lambda, L, x_inv) != 0) { continue; }
+
+    // Forney, the formal derivative keeps the odd terms of lambda
+    uint8_t derivative = 0;
+    for (std::size_t j = 1; j <= L; j += 2) {
+      derivative ^= mul(lambda[j], power(gf.log[x_inv] * (j - 1)));
+    }
+    if (derivative == 0) { return false; }
+    block[n - 1 - p] ^= div(evaluate(omega, nsym - 1, x_inv), derivative);
+    ++found;
+  }
+  return found == L;
+}
+
+/**
+ * \brief  Correct the codewords of a symbol in place
+ *
+ * Codeword i of the data and of the ECC part belongs to block i % blocks,
+ * only the data codewords are written back.
+ *
+ * \param[in]      symbol     Symbol size
+ * \param[in,out]  codewords  symbol.data data codewords followed by
+ *                            symbol.ecc ECC codewords
+ *
+ * \return  false if any block is uncorrectable
+ */
+inline bool correct(const Symbol & symbol, uint8_t * codewords) {
+  const std::size_t blocks = symbol.blocks;
+  const std::size_t nsym   = symbol.ecc / blocks;
+
+  uint8_t block[255];
+  for (std::size_t b = 0; b < blocks; ++b) {
+    std::size_t n = 0;
+    for (std::size_t i = b; i < symbol.data; i += blocks) {
+      block[n++] = codewords[i];
+    }
+    for (std::size_t i = b; i < symbol.ecc; i += blocks) {
+      block[n++] = codewords[symbol.data + i];
+    }
+
+    if (!correct(block, n, nsym)) { return false; }
+
+    std::size_t k = 0;
+    for (std::size_t i = b; i < symbol.data; i += blocks) {
+      codewords[i] = block[k++];
+    }
+  }
+  return true;
+}
+
+/**
+ * \brief  Decode the data codewords of a symbol
+ *
+ * Supports the ASCII, C40, Text and Base 256 encodation schemes, including
+ * FNC1, upper shift and the 05/06 macros. ANSI X12, EDIFACT, ECI and
+ * structured append are rejected.
+ *
+ * \param[in]   data  Corrected data codewords
+ * \param[in]   n     Number of data codewords
+ * \param[out]  out   Decoded bytes are appended
+ *
+ * \return  false on an invalid or unsupported codeword sequence
+ */
+inline bool decode_data(const uint8_t *        data,
+                        std::size_t            n,
+                        std::vector<uint8_t> & out) {
+  const char * trailer = "";
+  bool         upper   = false;
+
+  std::size_t k = 0;
+  while (k < n) {
+    const uint8_t cw = data[k++];
+    if (cw == 0) { return false; }
+    if (cw <= 128) {
+      out.push_back(static_cast<uint8_t>(upper ? cw - 1 + 128 : cw - 1));
+      upper = false;
+      continue;
+    }
+    if (cw == 129) {
+      // Padding up to the end of the symbol
+      break;
+    }
+    if (cw <= 229) {
+      out.push_back(static_cast<uint8_t>('0' + (cw - 130) / 10));
+      out.push_back(static_cast<uint8_t>('0' + (cw - 130) % 10));
+      continue;
+    }
+
+    switch (cw) {
+      case 230:
+      case 239:
+        if (!detail::decode_triples(data, n, k, cw == 239, out)) {
+          return false;
+        }
+        break;
+      case 231:
+        if (!detail::decode_base256(data, n, k, out)) { return false; }
+        break;
+      case 232: out.push_back(29); break;
+      case 235: upper = true; break;
+      case 236:
+      case 237: {
+        // Adjacent literals keep the digits out of the hex escapes
+        const char * header =
+          cw == 236 ? "[)>\x1E" "05\x1D" : "[)>\x1E" "06\x1D";
+        out.insert(out.end(), header, header + 7);
+        trailer = "\x1E\x04";
+        break;
+      }
+      default: return false;
+    }
+  }
+
+  for (; *trailer; ++trailer) {
+    out.push_back(static_cast<uint8_t>(*trailer));
+  }
+  return true;
+}
+
+}  // namespace ecc200
+}  // namespace balken
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__FINDER_H__INCLUDED
+#define BALKEN__FINDER_H__INCLUDED
+
+// cpp
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// own
+#include "ecc200.h"
+#include "types.h"
+
+namespace balken {
+namespace finder {
+
+/**
+ * Data Matrix symbol located by a Finder
+ */
+struct Location
+{
+  // Outer corners in the order of geometry::homography: top left, top right,
+  // bottom right and bottom left, which is the corner of the L
+  std::array<Point, 4> corners;
+  // Size read from the timing border, nullptr if the candidate was rejected
+  const ecc200::Symbol * symbol{nullptr};
+
+  explicit operator bool() const { return symbol != nullptr; }
+};
+
+namespace detail {
+
+struct Vector
+{
+  double i;
+  double j;
+};
+
+inline Vector operator+(Vector a, Vector b) { return {a.i + b.i, a.j + b.j}; }
+inline Vector operator-(Vector a, Vector b) { return {a.i - b.i, a.j - b.j}; }
+inline Vector operator*(double s, Vector a) { return {s * a.i, s * a.j}; }
+
+inline double length(Vector a) { return std::sqrt(a.i * a.i + a.j * a.j); }
+
+/**
+ * Statistics of the binarized samples along one side of a candidate
+ */
+struct Line
+{
+  std::size_t samples{0};
+  std::size_t dark{0};
+  std::size_t dark_runs{0};
+  // Interior runs are about as long as samples / (2 * dark_runs)
+  bool regular{false};
+
+  bool solid() const { return samples > 0 && 10 * dark >= 9 * samples; }
+
+  bool timing() const {
+    return regular && dark_runs >= 4 && 10 * dark >= 3 * samples &&
+           10 * dark <= 7 * samples;
+  }
+};
+
+}  // namespace detail
+
+/**
+ * Data Matrix finder pattern detector
+ *
+ * Checks a candidate rectangle, e.g. regions::minimal_bounding_rectangle of
+ * a region, for the solid L and the alternating timing border of a Data
+ * Matrix symbol. Only a few lines along the sides of the rectangle are read:
+ *
+ *  1. The sides are moved inward until they meet the first dark line, which
+ *     crops the quiet zone and the margin of the detection.
+ *  2. A line half a module inside every side must be solid on two adjacent
+ *     sides and alternate regularly on the other two.
+ *  3. The L fixes the orientation, the dark runs of the timing border give
+ *     the number of modules, which must match an ECC200 symbol size.
+ *
+ * Anything else is rejected before a module is sampled. Buffers are reused
+ * between candidates.
+ */
+class Finder
+{
+  using Vector = detail::Vector;
+  using Line   = detail::Line;
+
+public:
+  /**
+   * \param[in]  min_contrast  Minimal difference between the darkest and the
+   *                           brightest pixel of a candidate
+   */
+  explicit Finder(uint8_t min_contrast = 32) : _min_contrast{min_contrast} {}
+
+  /**
+   * \brief  Locate a Data Matrix symbol in a candidate rectangle
+   *
+   * \param[in]  img        Greyscale image
+   * \param[in]  rectangle  Oriented rectangle enclosing the candidate
+   *
+   * \return  Corners and size of the symbol, empty if rejected
+   */
+  template <class ImageT>
+  Location operator()(const ImageT & img, const Rectangle & rectangle) {
+    auto ret = Location();
+    if (img.rows() == 0 || img.columns() == 0) { return ret; }
+
+    std::array<Vector, 4> p;
+    for (std::size_t k = 0; k < 4; ++k) {
+      p[k] = Vector{static_cast<double>(rectangle.points[k].i),
+                    static_cast<double>(rectangle.points[k].j)};
+    }
+    if (std::min(length(p[1] - p[0]), length(p[2] - p[1])) < min_side) {
+      return ret;
+    }
+    if (!threshold(img, p)) { return ret; }
+
+    // Crop every side to the first line with dark pixels
+    std::array<double, 4> inset;
+    for (std::size_t k = 0; k < 4; ++k) {
+      if (!edge(img, p, k, inset[k])) { return ret; }
+    }
+    std::array<Vector, 4> c;
+    for (std::size_t k = 0; k < 4; ++k) {
+      const auto prev = (k + 3) % 4;
+      c[k] = p[k] + inset[prev] * normal(p, prev) + inset[k] * normal(p, k);
+    }
+
+    // Clockwise in image coordinates, like the top left, top right, bottom
+    // right and bottom left corners of an upright symbol
+    const auto a = c[1] - c[0];
+    const auto b = c[2] - c[1];
+    if (a.i * b.j - a.j * b.i > 0) { std::swap(c[1], c[3]); }
+
+    // Module size from the timing border, right inside the sides
+    std::array<Line, 4> lines;
+    std::size_t         dark_runs = 0;
+    double              pitch     = 0;
+    for (std::size_t k = 0; k < 4; ++k) {
+      lines[k] = scan_side(img, c, k, 1.);
+      if (lines[k].dark_runs > dark_runs) {
+        dark_runs = lines[k].dark_runs;
+        pitch     = lines[k].samples / (2. * dark_runs);
+      }
+    }
+    if (dark_runs < 4) { return ret; }
+
+    // Classify the sides in the middle of their outer modules
+    for (std::size_t k = 0; k < 4; ++k) {
+      lines[k] = scan_side(img, c, k, std::max(1., pitch / 2));
+    }
+    for (std::size_t k = 0; k < 4; ++k) {
+      // Left and bottom side of the L meet in the bottom left corner c[k]
+      if (!lines[(k + 3) % 4].solid() || !lines[k].solid() ||
+          !lines[(k + 1) % 4].timing() || !lines[(k + 2) % 4].timing()) {
+        continue;
+      }
+      const auto columns = 2 * lines[(k + 1) % 4].dark_runs;
+      const auto rows    = 2 * lines[(k + 2) % 4].dark_runs;
+      ret.symbol         = ecc200::find(rows, columns);
+      for (std::size_t n = 0; n < 4; ++n) {
+        const auto & corner = c[(k + 1 + n) % 4];
+        ret.corners[n]      = Point(static_cast<int>(std::lround(corner.i)),
+                               static_cast<int>(std::lround(corner.j)));
+      }
+      break;
+    }
+    return ret;
+  }
+
+private:
+  /**
+   * Unit normal of side k, pointing into the quadrilateral
+   */
+  static Vector normal(const std::array<Vector, 4> & q, std::size_t k) {
+    const auto n = q[(k + 2) % 4] - q[(k + 1) % 4];
+    return (1. / length(n)) * n;
+  }
+
+  /**
+   * Threshold halfway between the darkest and the brightest pixel of a
+   * coarse grid over the candidate, false for too little contrast
+   */
+  template <class ImageT>
+  bool threshold(const ImageT & img, const std::array<Vector, 4> & p) {
+    uint8_t min = 255;
+    uint8_t max = 0;
+    for (std::size_t r = 0; r < grid; ++r) {
+      for (std::size_t s = 0; s < grid; ++s) {
+        const double u     = (s + 0.5) / grid;
+        const double v     = (r + 0.5) / grid;
+        const auto   value = at(img, p[0] + u * (p[1] - p[0]) +
+                                       v * (p[3] - p[0]));
+        min                = std::min(min, value);
+        max                = std::max(max, value);
+      }
+    }
+    _threshold = static_cast<uint8_t>((min + max + 1) / 2);
+    return max - min >= _min_contrast;
+  }
+
+  /**
+   * Distance of the first line parallel to side k that is at least 30% as
+   * dark as the darkest one within a quarter of the depth
+   */
+  template <class ImageT>
+  bool edge(const ImageT &                img,
+            const std::array<Vector, 4> & p,
+            std::size_t                   k,
+            double &                      ret) {
+    const auto n     = normal(p, k);
+    const auto depth = length(p[(k + 2) % 4] - p[(k + 1) % 4]);
+    const auto steps = static_cast<std::size_t>(depth / 4) + 1;
+
+    _profile.resize(steps);
+    for (std::size_t t = 0; t < steps; ++t) {
+      const auto offset = static_cast<double>(t) * n;
+      _profile[t] = scan(img, p[k] + offset, p[(k + 1) % 4] + offset).dark;
+    }
+
+    const auto darkest = *std::max_element(_profile.begin(), _profile.end());
+    if (darkest == 0) { return false; }
+    for (std::size_t t = 0; t < steps; ++t) {
+      if (10 * _profile[t] >= 3 * darkest) {
+        ret = static_cast<double>(t);
+        break;
+      }
+    }
+    return true;
+  }
+
+  template <class ImageT>
+  Line scan_side(const ImageT &                img,
+                 const std::array<Vector, 4> & c,
+                 std::size_t                   k,
+                 double                        inset) {
+    const auto offset = inset * normal(c, k);
+    return scan(img, c[k] + offset, c[(k + 1) % 4] + offset);
+  }
+
+  /**
+   * Binarize the pixels along the segment from a to b, one per pixel of
+   * length, and collect their runs
+   */
+  template <class ImageT>
+  Line scan(const ImageT & img, Vector a, Vector b) {
+    auto       ret = Line();
+    const auto d   = b - a;
+    ret.samples    = static_cast<std::size_t>(length(d)) + 1;
+
+    _runs.clear();
+    bool previous = false;
+    for (std::size_t s = 0; s < ret.samples; ++s) {
+      const bool dark =
+        at(img, a + ((s + 0.5) / ret.samples) * d) < _threshold;
+      if (dark) { ++ret.dark; }
+      if (s == 0 || dark != previous) {
+        _runs.push_back(0);
+        if (dark) { ++ret.dark_runs; }
+      }
+      ++_runs.back();
+      previous = dark;
+    }
+
+    // The runs at both ends may be cut by the corners
+    if (ret.dark_runs == 0 || _runs.size() < 3) { return ret; }
+    const double pitch = ret.samples / (2. * ret.dark_runs);
+    ret.regular        = std::all_of(
+      _runs.begin() + 1, _runs.end() - 1, [pitch](std::size_t run) {
+        return run >= pitch / 2 && run <= 3 * pitch / 2;
+      });
+    return ret;
+  }
+
+  /**
+   * Nearest pixel, clamped to the image
+   */
+  template <class ImageT>
+  static uint8_t at(const ImageT & img, Vector p) {
+    const auto i = std::min<long>(
+      std::max<long>(std::lround(p.i), 0), static_cast<long>(img.rows()) - 1);
+    const auto j = std::min<long>(std::max<long>(std::lround(p.j), 0),
+                                  static_cast<long>(img.columns()) - 1);
+    return img(static_cast<std::size_t>(i), static_cast<std::size_t>(j));
+  }
+
+private:
+  // Smallest symbol side of 8 modules with at least 2 pixels each
+  static constexpr double      min_side = 16;
+  static constexpr std::size_t grid     = 16;
+
+  const uint8_t            _min_contrast;
+  uint8_t                  _threshold{128};
+  std::vector<std::size_t> _profile;
+  std::vector<std::size_t> _runs;
+};
+
+}  // namespace finder
+}  // namespace balken
+
+#endif
@@ -15,18 +15,39 @@
 #include <iostream>
 #include <limits>
 #include <numeric>
+#include <type_traits>
 #include <vector>
 
 // external
 #include <blaze/math/DynamicMatrix.h>
 
 // own
+#include "arena.h"
+#include "parallel.h"
 #include "util.h"
 
 namespace balken {
 namespace edt {
+
+/**
+ * Distance metrics supported by transform()
+ */
+enum class Metric { manhattan, chessboard, euclidean };
+
 namespace detail {
 
+/**
+ * Set every element of a distance map, which may live in a frame arena
+ */
+template <class DistanceMapT, class T>
+void fill(DistanceMapT & distance_map, T value) {
+  for (size_t i = 0UL; i < distance_map.rows(); ++i) {
+    for (size_t j = 0UL; j < distance_map.columns(); ++j) {
+      distance_map(i, j) = value;
+    }
+  }
+}
+
 /**
  * Calculate manhattan distance between two points p1 and p2
  */
@@ -70,71 +91,356 @@ constexpr bool is_background(const ImageT & img, PointT p) {
 }
 
 /**
- * Fast Independent Scanning Algorithm
+ * Row phase of the fast independent scanning algorithm for row i
  */
-template <class ImageT>
-auto fast_independent_scan(const ImageT & img) {
-  auto distance_map = blaze::DynamicMatrix<uint16_t, blaze::rowMajor>(
-    img.rows(), img.columns(), std::numeric_limits<uint16_t>::max());
+template <class ImageT, class DistanceMapT>
+void scan_row(const ImageT & img, size_t i, DistanceMapT & distance_map) {
+  using DistT = std::decay_t<decltype(distance_map(0, 0))>;
 
-  // Row Scanning
-  for (size_t i = 0UL; i < img.rows(); ++i) {
-    // left to right sweep
-    for (size_t j = 0UL; j < img.columns(); ++j) {
-      if (detail::is_object(img, std::make_pair(i, j))) {
-        if (j != 0) {
-          if (distance_map(i, j - 1) != std::numeric_limits<uint16_t>::max()) {
-            distance_map(i, j) =
-              static_cast<uint16_t>(distance_map(i, j - 1) + 1);
-          }
+  // left to right sweep
+  for (size_t j = 0UL; j < img.columns(); ++j) {
+    if (detail::is_object(img, std::make_pair(i, j))) {
+      if (j != 0) {
+        if (distance_map(i, j - 1) != std::numeric_limits<DistT>::max()) {
+          distance_map(i, j) = static_cast<DistT>(distance_map(i, j - 1) + 1);
         }
-      } else {
-        distance_map(i, j) = 0;
       }
+    } else {
+      distance_map(i, j) = 0;
     }
+  }
 
-    // right to left sweep
-    for (int j = img.columns() - 1; j >= 0; --j) {
-      if (detail::is_object(img, std::make_pair(i, j))) {
-        if (j != static_cast<int>(img.columns()) - 1) {
-          if (distance_map(i, j + 1) != std::numeric_limits<uint16_t>::max()) {
-            distance_map(i, j) =
-              std::min(static_cast<uint16_t>(distance_map(i, j)),
-                       static_cast<uint16_t>(distance_map(i, j + 1) + 1));
-          }
+  // right to left sweep
+  for (int j = img.columns() - 1; j >= 0; --j) {
+    if (detail::is_object(img, std::make_pair(i, j))) {
+      if (j != static_cast<int>(img.columns()) - 1) {
+        if (distance_map(i, j + 1) != std::numeric_limits<DistT>::max()) {
+          distance_map(i, j) =
+            std::min(static_cast<DistT>(distance_map(i, j)),
+                     static_cast<DistT>(distance_map(i, j + 1) + 1));
         }
       }
     }
   }
+}
 
-  // Column Scanning
-  for (size_t j = 0UL; j < img.columns(); ++j) {
-    // top -> bottom
-    for (size_t i = 0UL; i < img.rows(); ++i) {
-      if (detail::is_object(img, std::make_pair(i, j))) {
-        if (i != 0) {
-          if (distance_map(i - 1, j) != std::numeric_limits<uint16_t>::max()) {
-            distance_map(i, j) =
-              std::min(static_cast<uint16_t>(distance_map(i, j)),
-                       static_cast<uint16_t>(distance_map(i - 1, j) + 1));
-          }
-        }
+/**
+ * Column phase of the fast independent scanning algorithm for columns
+ * [j0, j1)
+ *
+ * The sweeps run over whole row segments of the strip, so consecutive
+ * accesses stay within the same cache lines instead of striding over rows.
+ */
+template <class ImageT, class DistanceMapT>
+void scan_columns(const ImageT & img,
+                  size_t         j0,
+                  size_t         j1,
+                  DistanceMapT & distance_map) {
+  using DistT        = std::decay_t<decltype(distance_map(0, 0))>;
+  constexpr auto inf = std::numeric_limits<DistT>::max();
+
+  // top -> bottom
+  for (size_t i = 1UL; i < img.rows(); ++i) {
+    for (size_t j = j0; j < j1; ++j) {
+      if (detail::is_object(img, std::make_pair(i, j)) &&
+          distance_map(i - 1, j) != inf) {
+        distance_map(i, j) =
+          std::min(static_cast<DistT>(distance_map(i, j)),
+                   static_cast<DistT>(distance_map(i - 1, j) + 1));
       }
     }
+  }
 
-    // bottom -> top
-    for (int i = img.rows() - 1; i >= 0; --i) {
-      if (detail::is_object(img, std::make_pair(i, j))) {
-        if (i != static_cast<int>(img.rows() - 1)) {
-          if (distance_map(i + 1, j) != std::numeric_limits<uint16_t>::max()) {
-            distance_map(i, j) =
-              std::min(static_cast<uint16_t>(distance_map(i, j)),
-                       static_cast<uint16_t>(distance_map(i + 1, j) + 1));
-          }
-        }
+  // bottom -> top
+  for (int i = static_cast<int>(img.rows()) - 2; i >= 0; --i) {
+    for (size_t j = j0; j < j1; ++j) {
+      if (detail::is_object(img, std::make_pair(i, j)) &&
+          distance_map(i + 1, j) != inf) {
+        distance_map(i, j) =
+          std::min(static_cast<DistT>(distance_map(i, j)),
+                   static_cast<DistT>(distance_map(i + 1, j) + 1));
       }
     }
   }
+}
+
+/**
+ * Fast Independent Scanning Algorithm
+ *
+ * Computes the city-block (L1) distance of every object pixel to the
+ * nearest background pixel.
+ */
+template <class ImageT, class DistanceMapT>
+void fast_independent_scan(const ImageT & img,
+                           DistanceMapT & distance_map,
+                           size_t         strip = 64) {
+  using dist_t = std::decay_t<decltype(distance_map(0, 0))>;
+  fill(distance_map, std::numeric_limits<dist_t>::max());
+
+  // Row Scanning
+  for (size_t i = 0UL; i < img.rows(); ++i) {
+    scan_row(img, i, distance_map);
+  }
+
+  // Column Scanning
+  for (size_t j = 0UL; j < img.columns(); j += strip) {
+    scan_columns(img, j, std::min(img.columns(), j + strip), distance_map);
+  }
+}
+
+template <class ImageT, class DistT = uint16_t>
+auto fast_independent_scan(const ImageT & img, size_t strip = 64) {
+  auto distance_map =
+    blaze::DynamicMatrix<DistT, blaze::rowMajor>(img.rows(), img.columns());
+  fast_independent_scan(img, distance_map, strip);
+  return distance_map;
+}
+
+/**
+ * Fast Independent Scanning Algorithm, rows and column strips distributed
+ * over the threads of a pool
+ */
+template <class ImageT, class DistT = uint16_t>
+auto fast_independent_scan(const ImageT &         img,
+                           parallel::ThreadPool & pool,
+                           size_t                 strip = 64) {
+  auto distance_map = blaze::DynamicMatrix<DistT, blaze::rowMajor>(
+    img.rows(), img.columns(), std::numeric_limits<DistT>::max());
+
+  pool.parallel_for(img.rows(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) { scan_row(img, i, distance_map); }
+  });
+
+  const auto strips = (img.columns() + strip - 1) / strip;
+  pool.parallel_for(strips, [&](size_t begin, size_t end) {
+    for (size_t s = begin; s < end; ++s) {
+      scan_columns(img,
+                   s * strip,
+                   std::min(img.columns(), (s + 1) * strip),
+                   distance_map);
+    }
+  });
+  return distance_map;
+}
+
+/**
+ * Two-pass chamfer transform with unit weights on the 8-neighborhood, exact
+ * for the chessboard distance.
+ */
+template <class ImageT, class DistanceMapT>
+void chessboard_scan(const ImageT & img, DistanceMapT & distance_map) {
+  constexpr auto inf     = std::numeric_limits<uint32_t>::max();
+  const auto     rows    = static_cast<int>(img.rows());
+  const auto     columns = static_cast<int>(img.columns());
+
+  fill(distance_map, inf);
+
+  auto relax = [&](int i, int j, int k, int l) {
+    if (k < 0 || k >= rows || l < 0 || l >= columns) { return; }
+    if (distance_map(k, l) != inf) {
+      distance_map(i, j) =
+        std::min(distance_map(i, j), distance_map(k, l) + 1);
+    }
+  };
+
+  // top-left -> bottom-right
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < columns; ++j) {
+      if (!detail::is_object(img, std::make_pair(i, j))) {
+        distance_map(i, j) = 0;
+        continue;
+      }
+      relax(i, j, i - 1, j - 1);
+      relax(i, j, i - 1, j);
+      relax(i, j, i - 1, j + 1);
+      relax(i, j, i, j - 1);
+    }
+  }
+
+  // bottom-right -> top-left
+  for (int i = rows - 1; i >= 0; --i) {
+    for (int j = columns - 1; j >= 0; --j) {
+      relax(i, j, i + 1, j + 1);
+      relax(i, j, i + 1, j);
+      relax(i, j, i + 1, j - 1);
+      relax(i, j, i, j + 1);
+    }
+  }
+}
+
+template <class ImageT>
+auto chessboard_scan(const ImageT & img) {
+  auto distance_map =
+    blaze::DynamicMatrix<uint32_t, blaze::rowMajor>(img.rows(), img.columns());
+  chessboard_scan(img, distance_map);
+  return distance_map;
+}
+
+/**
+ * Lower envelope of parabolas (Felzenszwalb & Huttenlocher)
+ *
+ * Computes d[q] = min_p (q - p)^2 + f[p] over a line of n values, where
+ * entries equal to inf do not contribute. v and z are scratch buffers of
+ * size n and n + 1.
+ */
+inline void lower_envelope(const uint32_t * f,
+                           uint32_t *       d,
+                           std::size_t      n,
+                           int *            v,
+                           double *         z) {
+  constexpr auto inf   = std::numeric_limits<uint32_t>::max();
+  constexpr auto inf_d = std::numeric_limits<double>::infinity();
+
+  auto parabola = [f](int q) {
+    return static_cast<int64_t>(f[q]) + static_cast<int64_t>(q) * q;
+  };
+
+  int k = -1;
+  for (int q = 0; q < static_cast<int>(n); ++q) {
+    if (f[q] == inf) { continue; }
+    double s = -inf_d;
+    while (k >= 0) {
+      s = static_cast<double>(parabola(q) - parabola(v[k])) / (2 * (q - v[k]));
+      if (s > z[k]) { break; }
+      --k;
+    }
+    ++k;
+    v[k]     = q;
+    z[k]     = k == 0 ? -inf_d : s;
+    z[k + 1] = inf_d;
+  }
+
+  if (k < 0) {
+    std::fill_n(d, n, inf);
+    return;
+  }
+
+  k = 0;
+  for (int q = 0; q < static_cast<int>(n); ++q) {
+    while (z[k + 1] < q) { ++k; }
+    const int64_t dq = q - v[k];
+    d[q]             = static_cast<uint32_t>(dq * dq + f[v[k]]);
+  }
+}
+
+/**
+ * Row phase of the squared euclidean transform for row i
+ */
+template <class ImageT, class DistanceMapT>
+void squared_row(const ImageT & img, size_t i, DistanceMapT & distance_map) {
+  constexpr auto inf = std::numeric_limits<uint32_t>::max();
+
+  scan_row(img, i, distance_map);
+  for (std::size_t j = 0; j < img.columns(); ++j) {
+    auto & d = distance_map(i, j);
+    if (d != inf) { d *= d; }
+  }
+}
+
+/**
+ * Scratch space for envelope_columns
+ */
+struct EnvelopeBuffers
+{
+  EnvelopeBuffers(std::size_t rows, std::size_t tile, arena::FrameArena & a)
+   : tile(a.allocate<uint32_t>(tile * rows)),
+     line(a.allocate<uint32_t>(rows)),
+     v(a.allocate<int>(rows)),
+     z(a.allocate<double>(rows + 1)) {}
+
+  uint32_t * tile;
+  uint32_t * line;
+  int *      v;
+  double *   z;
+};
+
+/**
+ * Column phase of the squared euclidean transform for columns [j0, j1)
+ *
+ * The columns are transposed into a contiguous buffer first, so the
+ * lower envelope does not stride over the row-major matrix.
+ */
+template <class DistanceMapT>
+void envelope_columns(DistanceMapT &    distance_map,
+                      std::size_t       j0,
+                      std::size_t       j1,
+                      EnvelopeBuffers & buf) {
+  const auto rows  = distance_map.rows();
+  const auto width = j1 - j0;
+
+  for (std::size_t i = 0; i < rows; ++i) {
+    for (std::size_t b = 0; b < width; ++b) {
+      buf.tile[b * rows + i] = distance_map(i, j0 + b);
+    }
+  }
+  for (std::size_t b = 0; b < width; ++b) {
+    std::copy_n(&buf.tile[b * rows], rows, buf.line);
+    lower_envelope(buf.line, &buf.tile[b * rows], rows, buf.v, buf.z);
+  }
+  for (std::size_t i = 0; i < rows; ++i) {
+    for (std::size_t b = 0; b < width; ++b) {
+      distance_map(i, j0 + b) = buf.tile[b * rows + i];
+    }
+  }
+}
+
+/**
+ * Exact squared euclidean distance transform
+ *
+ * Rows are solved by two sweeps, columns by lower_envelope on tiles of
+ * columns.
+ */
+template <class ImageT, class DistanceMapT>
+void squared_euclidean(const ImageT &      img,
+                       DistanceMapT &      distance_map,
+                       arena::FrameArena & scratch,
+                       std::size_t         tile = 32) {
+  fill(distance_map, std::numeric_limits<uint32_t>::max());
+  for (std::size_t i = 0; i < img.rows(); ++i) {
+    squared_row(img, i, distance_map);
+  }
+
+  auto buf = EnvelopeBuffers(img.rows(), tile, scratch);
+  for (std::size_t j = 0; j < img.columns(); j += tile) {
+    envelope_columns(distance_map, j, std::min(img.columns(), j + tile), buf);
+  }
+}
+
+template <class ImageT>
+auto squared_euclidean(const ImageT & img, std::size_t tile = 32) {
+  auto distance_map =
+    blaze::DynamicMatrix<uint32_t, blaze::rowMajor>(img.rows(), img.columns());
+  arena::FrameArena scratch;
+  squared_euclidean(img, distance_map, scratch, tile);
+  return distance_map;
+}
+
+/**
+ * Exact squared euclidean distance transform, rows and column tiles
+ * distributed over the threads of a pool
+ */
+template <class ImageT>
+auto squared_euclidean(const ImageT &         img,
+                       parallel::ThreadPool & pool,
+                       std::size_t            tile = 32) {
+  auto distance_map = blaze::DynamicMatrix<uint32_t, blaze::rowMajor>(
+    img.rows(), img.columns(), std::numeric_limits<uint32_t>::max());
+
+  pool.parallel_for(img.rows(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) { squared_row(img, i, distance_map); }
+  });
+
+  const auto tiles = (img.columns() + tile - 1) / tile;
+  pool.parallel_for(tiles, [&](size_t begin, size_t end) {
+    arena::FrameArena scratch;
+    auto              buf = EnvelopeBuffers(img.rows(), tile, scratch);
+    for (size_t t = begin; t < end; ++t) {
+      envelope_columns(distance_map,
+                       t * tile,
+                       std::min(img.columns(), (t + 1) * tile),
+                       buf);
+    }
+  });
   return distance_map;
 }
 
@@ -145,12 +451,68 @@ decltype(auto) transform(ImageT && img) {
   return detail::fast_independent_scan(std::forward<ImageT>(img));
 }
 
+/**
+ * \brief  Distance transform with selectable metric
+ *
+ * \param[in]  img     Binary image, object pixels are 0
+ * \param[in]  metric  Distance metric, euclidean distances are squared
+ * \return     Distance map, max() where no background pixel exists
+ */
+template <class ImageT>
+blaze::DynamicMatrix<uint32_t, blaze::rowMajor> transform(const ImageT & img,
+                                                          Metric metric) {
+  switch (metric) {
+    case Metric::chessboard: return detail::chessboard_scan(img);
+    case Metric::euclidean: return detail::squared_euclidean(img);
+    default: return detail::fast_independent_scan<ImageT, uint32_t>(img);
+  }
+}
+
+/**
+ * \brief  Distance transform with selectable metric on a thread pool
+ *
+ * Row and column phases of the manhattan and euclidean metric are split
+ * across the pool. The chessboard chamfer scan is inherently sequential and
+ * runs on the calling thread.
+ */
+template <class ImageT>
+blaze::DynamicMatrix<uint32_t, blaze::rowMajor> transform(
+  const ImageT & img, Metric metric, parallel::ThreadPool & pool) {
+  switch (metric) {
+    case Metric::chessboard: return detail::chessboard_scan(img);
+    case Metric::euclidean: return detail::squared_euclidean(img, pool);
+    default:
+      return detail::fast_independent_scan<ImageT, uint32_t>(img, pool);
+  }
+}
+
+/**
+ * \brief  Distance transform with selectable metric, the distance map and
+ *         all intermediates are allocated from a frame arena
+ */
+template <class ImageT>
+arena::Matrix<uint32_t> transform(const ImageT &      img,
+                                  Metric              metric,
+                                  arena::FrameArena & arena) {
+  auto distance_map = arena.matrix<uint32_t>(img.rows(), img.columns());
+  switch (metric) {
+    case Metric::chessboard: detail::chessboard_scan(img, distance_map); break;
+    case Metric::euclidean:
+      detail::squared_euclidean(img, distance_map, arena);
+      break;
+    default: detail::fast_independent_scan(img, distance_map); break;
+  }
+  return distance_map;
+}
+
 template <class DistanceMapT>
 auto prune(DistanceMapT && dm) {
-  auto means = std::vector<uint16_t>(dm.rows());
+  using value_t = std::decay_t<decltype(dm(0, 0))>;
+  auto means    = std::vector<value_t>(dm.rows());
 
   for (size_t i = 0; i < dm.rows(); ++i) {
-    means[i] = std::accumulate(dm.begin(i), dm.end(i), 0) / dm.columns();
+    means[i] = static_cast<value_t>(
+      std::accumulate(dm.begin(i), dm.end(i), uint64_t{0}) / dm.columns());
   }
 
   auto min_avg_el = *std::min_element(means.begin(), means.end());
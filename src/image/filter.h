@@ -11,8 +11,18 @@
 
 #include <blaze/math/DynamicMatrix.h>
 #include <blaze/math/StaticMatrix.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
 
+#include "integral.h"
+#include "lut.h"
+#include "simd.h"
 #include "view.h"
 
 namespace balken {
@@ -37,6 +47,139 @@ auto sobel_neg_45 =
 
 }  // namespace detail
 
+/**
+ * Separable kernel in fixed-point representation.
+ *
+ * The kernel is the outer product column * row, where every coefficient is
+ * stored as an integer scaled by 2^row_shift and 2^column_shift respectively.
+ * An empty kernel signals that the source kernel is not separable.
+ */
+struct SeparableKernel
+{
+  std::vector<int16_t> row;
+  std::vector<int16_t> column;
+  unsigned             row_shift{0};
+  unsigned             column_shift{0};
+
+  std::size_t rows() const { return column.size(); }
+  std::size_t columns() const { return row.size(); }
+  bool        empty() const { return row.empty() || column.empty(); }
+
+  /**
+   * Upper bound of any intermediate or final accumulator value for 8 bit
+   * input, including the rounding offset.
+   */
+  long bound() const {
+    long r = 0;
+    long c = 0;
+    for (auto v : row) { r += std::abs(v); }
+    for (auto v : column) { c += std::abs(v); }
+    const auto shift = row_shift + column_shift;
+    return 255 * r * c + (shift ? 1L << (shift - 1) : 0);
+  }
+};
+
+namespace detail {
+
+/**
+ * Smallest shift representing all coefficients exactly, or the largest shift
+ * keeping the sum of the scaled coefficients within budget. Small exact
+ * kernels end up within the int16 bound of SeparableKernel.
+ */
+inline unsigned fixed_point_shift(const std::vector<float> & coeffs) {
+  // Keep 255 * sum(|row|) * sum(|column|) within int32 for both passes
+  const float budget = std::sqrt(2147483647.0f / 255.0f);
+
+  float sum = 0;
+  for (auto c : coeffs) { sum += std::abs(c); }
+
+  unsigned best = 0;
+  for (unsigned shift = 0; shift < 16; ++shift) {
+    const float scale = static_cast<float>(1 << shift);
+    if (sum * scale > budget) { break; }
+    best       = shift;
+    bool exact = true;
+    for (auto c : coeffs) {
+      exact &= std::abs(c * scale - std::round(c * scale)) < 1e-4f;
+    }
+    if (exact) { break; }
+  }
+  return best;
+}
+
+inline std::vector<int16_t> quantize(const std::vector<float> & coeffs,
+                                     unsigned                   shift) {
+  auto ret = std::vector<int16_t>(coeffs.size());
+  for (std::size_t i = 0; i < coeffs.size(); ++i) {
+    ret[i] = static_cast<int16_t>(std::round(coeffs[i] * (1 << shift)));
+  }
+  return ret;
+}
+
+}  // namespace detail
+
+/**
+ * \brief  Build a fixed-point separable kernel from its two factors
+ *
+ * \param[in]  row     Horizontal factor
+ * \param[in]  column  Vertical factor
+ * \return     Kernel equal to column * row
+ */
+inline SeparableKernel make_separable(const std::vector<float> & row,
+                                      const std::vector<float> & column) {
+  auto ret         = SeparableKernel();
+  ret.row_shift    = detail::fixed_point_shift(row);
+  ret.column_shift = detail::fixed_point_shift(column);
+  ret.row          = detail::quantize(row, ret.row_shift);
+  ret.column       = detail::quantize(column, ret.column_shift);
+  return ret;
+}
+
+/**
+ * \brief  Decompose a kernel into a row and a column factor
+ *
+ * \param[in]  kernel  Kernel matrix
+ * \return     Fixed-point kernel, empty if kernel has rank > 1
+ */
+template <class KernelT>
+SeparableKernel make_separable(const KernelT & kernel) {
+  // Pivot on the largest coefficient
+  std::size_t p = 0;
+  std::size_t q = 0;
+  for (std::size_t h = 0; h < kernel.rows(); ++h) {
+    for (std::size_t w = 0; w < kernel.columns(); ++w) {
+      if (std::abs(kernel(h, w)) > std::abs(kernel(p, q))) {
+        p = h;
+        q = w;
+      }
+    }
+  }
+  if (kernel(p, q) == 0) { return SeparableKernel(); }
+
+  auto row    = std::vector<float>(kernel.columns());
+  auto column = std::vector<float>(kernel.rows());
+  for (std::size_t w = 0; w < kernel.columns(); ++w) {
+    row[w] = kernel(p, w) / kernel(p, q);
+  }
+  for (std::size_t h = 0; h < kernel.rows(); ++h) { column[h] = kernel(h, q); }
+
+  for (std::size_t h = 0; h < kernel.rows(); ++h) {
+    for (std::size_t w = 0; w < kernel.columns(); ++w) {
+      if (std::abs(column[h] * row[w] - kernel(h, w)) > 1e-5f) {
+        return SeparableKernel();
+      }
+    }
+  }
+
+  // Normalize the row so both factors use a similar range
+  float norm = 0;
+  for (auto v : row) { norm += std::abs(v); }
+  for (auto & v : row) { v /= norm; }
+  for (auto & v : column) { v *= norm; }
+
+  return make_separable(row, column);
+}
+
 namespace views {
 
 template <class ImageT>
@@ -67,34 +210,255 @@ decltype(auto) binarize(const ImageT & img, std::size_t threshold) {
   return BinaryView<ImageT>(img, threshold);
 }
 
+/**
+ * Binarizing a table lookup is fused into the table
+ */
+template <class ImageT>
+decltype(auto) binarize(const lut::views::LutView<ImageT> & img,
+                        std::size_t                         threshold) {
+  return lut::views::apply(img,
+                           lut::threshold(static_cast<uint8_t>(threshold)));
+}
+
+/**
+ * Local threshold rules of AdaptiveBinaryView
+ */
+enum class Adaptive {
+  bradley,  ///< Above (1 - k) times the local mean
+  sauvola   ///< Above mean * (1 + k * (deviation / 128 - 1))
+};
+
+/**
+ * Binarization against a threshold derived from the (2 radius + 1)^2
+ * window around every pixel, clipped at the image border.
+ *
+ * Window sums are answered in constant time from an integral image with
+ * squares built once on construction, so the cost per pixel does not
+ * depend on the radius. Copies share the integral image.
+ */
+template <class ImageT>
+class AdaptiveBinaryView
+  : public view::ViewBase<ImageT, AdaptiveBinaryView<ImageT>>
+{
+  using self_t = AdaptiveBinaryView<ImageT>;
+  using base_t = view::ViewBase<ImageT, self_t>;
+
+public:
+  using ElementType = typename ImageT::ElementType;
+
+public:
+  AdaptiveBinaryView(const ImageT & img,
+                     std::size_t    radius,
+                     float          k,
+                     Adaptive       method)
+   : base_t(img),
+     _sums{std::make_shared<const integral::IntegralImage<>>(
+       img, method == Adaptive::sauvola)},
+     _radius{radius},
+     _k{k},
+     _method{method} {}
+
+public:
+  ElementType view_element(std::size_t i, std::size_t j) const {
+    const std::size_t i0 = i > _radius ? i - _radius : 0;
+    const std::size_t j0 = j > _radius ? j - _radius : 0;
+    const std::size_t i1 = std::min(this->_img.rows(), i + _radius + 1);
+    const std::size_t j1 = std::min(this->_img.columns(), j + _radius + 1);
+
+    const float mean      = _sums->mean(i0, j0, i1, j1);
+    float       threshold = mean * (1.F - _k);
+    if (_method == Adaptive::sauvola) {
+      const float deviation = std::sqrt(_sums->variance(i0, j0, i1, j1));
+      threshold             = mean * (1.F + _k * (deviation / 128.F - 1.F));
+    }
+    return this->_img(i, j) > threshold ? 255 : 0;
+  }
+
+private:
+  std::shared_ptr<const integral::IntegralImage<>> _sums;
+  std::size_t                                      _radius;
+  float                                            _k;
+  Adaptive                                         _method;
+};
+
+/**
+ * \brief  Bradley-Roth binarization, pixels darker than (1 - k) times the
+ *         local mean become 0
+ */
+template <class ImageT>
+decltype(auto) bradley(const ImageT & img,
+                       std::size_t    radius,
+                       float          k = 0.15F) {
+  return AdaptiveBinaryView<ImageT>(img, radius, k, Adaptive::bradley);
+}
+
+/**
+ * \brief  Sauvola binarization, the local threshold is lowered in windows
+ *         of low contrast
+ */
+template <class ImageT>
+decltype(auto) sauvola(const ImageT & img,
+                       std::size_t    radius,
+                       float          k = 0.2F) {
+  return AdaptiveBinaryView<ImageT>(img, radius, k, Adaptive::sauvola);
+}
+
 }  // namespace views
 
+/**
+ * Float reference convolution.
+ *
+ * Results are rounded and saturated to [0, 255]. Pixels whose neighborhood
+ * leaves the image are set to 0.
+ */
 template <class ImageT, class KernelT>
-blaze::DynamicMatrix<uint8_t, blaze::rowMajor> convolve(
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> convolve_float(
   const ImageT & img, const KernelT & kernel) {
   // Assert odd kernel dimensions
   assert(kernel.rows() % 2 != 0);
   assert(kernel.columns() % 2 != 0);
 
-  blaze::DynamicMatrix<uint8_t, blaze::rowMajor> ret(img.rows(),
-                                                     img.columns());
+  blaze::DynamicMatrix<uint8_t, blaze::rowMajor> ret(
+    img.rows(), img.columns(), 0UL);
+  if (img.rows() < kernel.rows() || img.columns() < kernel.columns()) {
+    return ret;
+  }
 
-  size_t floor_half_h = floor(kernel.rows() / 2);
-  size_t floor_half_w = floor(kernel.columns() / 2);
+  size_t floor_half_h = kernel.rows() / 2;
+  size_t floor_half_w = kernel.columns() / 2;
 
-  for (size_t i = 0UL; i < ret.rows() - kernel.rows(); ++i) {
-    for (size_t j = 0UL; j < ret.columns() - kernel.columns(); ++j) {
-      for (size_t h = i; h < kernel.rows(); ++h) {
-        for (size_t w = j; w < kernel.columns(); ++w) {
-          ret(i + floor_half_h, j + floor_half_w) += static_cast<uint8_t>(
-            kernel(i, j) * static_cast<float>(img(h + i, w + j)));
+  for (size_t i = 0UL; i <= ret.rows() - kernel.rows(); ++i) {
+    for (size_t j = 0UL; j <= ret.columns() - kernel.columns(); ++j) {
+      float sum = 0;
+      for (size_t h = 0; h < kernel.rows(); ++h) {
+        for (size_t w = 0; w < kernel.columns(); ++w) {
+          sum += kernel(h, w) * static_cast<float>(img(i + h, j + w));
         }
       }
+      sum = std::round(sum);
+      ret(i + floor_half_h, j + floor_half_w) =
+        static_cast<uint8_t>(sum < 0 ? 0 : sum > 255 ? 255 : sum);
+    }
+  }
+  return ret;
+}
+
+namespace detail {
+
+/**
+ * Horizontal then vertical pass of a separable kernel with accumulators of
+ * type AccT. Only the last kernel.rows() rows of the horizontal pass are
+ * kept in a ring buffer.
+ */
+template <class AccT>
+struct accumulate_row
+{
+  static void madd(AccT * acc, const AccT * src, int16_t c, std::size_t n) {
+    for (std::size_t j = 0; j < n; ++j) { acc[j] += src[j] * c; }
+  }
+  static void narrow(const AccT * src,
+                     uint8_t *    dst,
+                     unsigned     shift,
+                     std::size_t  n) {
+    const AccT round = shift ? AccT(1) << (shift - 1) : 0;
+    for (std::size_t j = 0; j < n; ++j) {
+      auto v = (src[j] + round) >> shift;
+      dst[j] = static_cast<uint8_t>(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+  }
+};
+
+template <>
+struct accumulate_row<int16_t>
+{
+  static void madd(int16_t *       acc,
+                   const int16_t * src,
+                   int16_t         c,
+                   std::size_t     n) {
+    simd::madd_row(acc, src, c, n);
+  }
+  static void narrow(const int16_t * src,
+                     uint8_t *       dst,
+                     unsigned        shift,
+                     std::size_t     n) {
+    simd::narrow_row(src, dst, shift, n);
+  }
+};
+
+template <class AccT, class ImageT>
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> convolve_separable(
+  const ImageT & img, const SeparableKernel & kernel) {
+  using row_t = accumulate_row<AccT>;
+
+  const std::size_t rows    = img.rows();
+  const std::size_t columns = img.columns();
+  const std::size_t k_h     = kernel.rows();
+  const std::size_t k_w     = kernel.columns();
+
+  blaze::DynamicMatrix<uint8_t, blaze::rowMajor> ret(rows, columns, 0UL);
+  if (rows < k_h || columns < k_w) { return ret; }
+
+  const std::size_t width = columns - k_w + 1;
+  auto              line  = std::vector<AccT>(columns);
+  auto              ring  = std::vector<AccT>(k_h * width);
+  auto              acc   = std::vector<AccT>(width);
+
+  for (std::size_t i = 0; i < rows; ++i) {
+    // Horizontal pass of row i
+    for (std::size_t j = 0; j < columns; ++j) { line[j] = img(i, j); }
+    AccT * h_row = &ring[(i % k_h) * width];
+    std::fill_n(h_row, width, 0);
+    for (std::size_t w = 0; w < k_w; ++w) {
+      row_t::madd(h_row, &line[w], kernel.row[w], width);
+    }
+    if (i + 1 < k_h) { continue; }
+
+    // Vertical pass over the last k_h horizontal rows
+    const std::size_t top = i + 1 - k_h;
+    std::fill(acc.begin(), acc.end(), 0);
+    for (std::size_t h = 0; h < k_h; ++h) {
+      row_t::madd(
+        acc.data(), &ring[((top + h) % k_h) * width], kernel.column[h], width);
     }
+    row_t::narrow(acc.data(),
+                  &ret(top + k_h / 2, k_w / 2),
+                  kernel.row_shift + kernel.column_shift,
+                  width);
   }
   return ret;
 }
 
+}  // namespace detail
+
+/**
+ * Convolve with a separable kernel in a horizontal and a vertical
+ * fixed-point pass. Uses int16 accumulators if the kernel allows it.
+ */
+template <class ImageT>
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> convolve(
+  const ImageT & img, const SeparableKernel & kernel) {
+  // Assert odd kernel dimensions
+  assert(kernel.rows() % 2 != 0);
+  assert(kernel.columns() % 2 != 0);
+
+  if (kernel.bound() <= std::numeric_limits<int16_t>::max()) {
+    return detail::convolve_separable<int16_t>(img, kernel);
+  }
+  return detail::convolve_separable<int32_t>(img, kernel);
+}
+
+/**
+ * Convolve with an arbitrary kernel. Separable kernels are detected and
+ * evaluated in fixed-point, all others fall back to convolve_float.
+ */
+template <class ImageT, class KernelT>
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> convolve(
+  const ImageT & img, const KernelT & kernel) {
+  auto separable = make_separable(kernel);
+  if (separable.empty()) { return convolve_float(img, kernel); }
+  return convolve(img, separable);
+}
+
 template <class ImageT>
 decltype(auto) gauss(const ImageT & img) {
   return convolve(img, detail::gauss_3x3);
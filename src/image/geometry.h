@@ -10,7 +10,11 @@
 #define BALKEN__GEOMETRY_H__INCLUDED
 
 // cpp
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <vector>
 
 // thirdparty
 #include <blaze/math/DynamicMatrix.h>
@@ -18,6 +22,7 @@
 #include <blaze/math/StaticVector.h>
 
 // own
+#include "types.h"
 #include "view.h"
 
 namespace balken {
@@ -185,6 +190,179 @@ decltype(auto) translate(const ImageT & img,
   return TranslatedView<ImageT>(img, i, j, heigth, width);
 }
 
+/**
+ * Projective mapping of the unit square onto a quadrilateral
+ *
+ * (u, v) maps to i = (y . [u v 1]) / (w . [u v 1]) and
+ * j = (x . [u v 1]) / (w . [u v 1]), u runs along the columns.
+ */
+struct Homography
+{
+  static constexpr double epsilon = 1e-9;
+
+  std::array<double, 3> x;
+  std::array<double, 3> y;
+  std::array<double, 3> w;
+
+  /**
+   * The denominator is affine in (u, v), so it is positive on the whole
+   * unit square if it is positive on its corners. False for degenerate
+   * quadrilaterals and for ones whose mapping passes through infinity.
+   */
+  bool valid() const {
+    return w[2] > epsilon && w[0] + w[2] > epsilon && w[1] + w[2] > epsilon &&
+           w[0] + w[1] + w[2] > epsilon;
+  }
+
+  // Image position {i, j} of (u, v)
+  std::array<double, 2> operator()(double u, double v) const {
+    const double d = w[0] * u + w[1] * v + w[2];
+    return {{(y[0] * u + y[1] * v + y[2]) / d,
+             (x[0] * u + x[1] * v + x[2]) / d}};
+  }
+};
+
+/**
+ * \brief  Homography of the unit square onto a quadrilateral
+ *
+ * \param[in]  corners  Images of (0, 0), (1, 0), (1, 1) and (0, 1), i.e.
+ *                      in order around the quadrilateral
+ */
+inline Homography homography(const std::array<Point, 4> & corners) {
+  const double x0 = corners[0].j, x1 = corners[1].j;
+  const double x2 = corners[2].j, x3 = corners[3].j;
+  const double y0 = corners[0].i, y1 = corners[1].i;
+  const double y2 = corners[2].i, y3 = corners[3].i;
+
+  const double sx = x0 - x1 + x2 - x3;
+  const double sy = y0 - y1 + y2 - y3;
+  double       g  = 0;
+  double       h  = 0;
+  if (sx != 0 || sy != 0) {
+    // Perspective part, zero for parallelograms
+    const double dx1 = x1 - x2, dx2 = x3 - x2;
+    const double dy1 = y1 - y2, dy2 = y3 - y2;
+    const double den = dx1 * dy2 - dx2 * dy1;
+    if (std::abs(den) < Homography::epsilon) {
+      // Three corners on a line, see Homography::valid()
+      return Homography{{0., 0., 0.}, {0., 0., 0.}, {0., 0., 0.}};
+    }
+    g = (sx * dy2 - dx2 * sy) / den;
+    h                = (dx1 * sy - sx * dy1) / den;
+  }
+  return Homography{{x1 - x0 + g * x1, x3 - x0 + h * x3, x0},
+                    {y1 - y0 + g * y1, y3 - y0 + h * y3, y0},
+                    {g, h, 1.}};
+}
+
+namespace detail {
+
+/**
+ * Bilinear interpolation at (i, j), clamped to the image. NaN coordinates
+ * clamp to 0, empty images read as 0.
+ */
+template <class ImageT>
+float bilinear(const ImageT & img, double i, double j) {
+  if (img.rows() == 0 || img.columns() == 0) { return 0.F; }
+
+  const double max_i = static_cast<double>(img.rows() - 1);
+  const double max_j = static_cast<double>(img.columns() - 1);
+  i                  = i > 0. ? std::min(i, max_i) : 0.;
+  j                  = j > 0. ? std::min(j, max_j) : 0.;
+
+  const auto  i0 = static_cast<std::size_t>(i);
+  const auto  j0 = static_cast<std::size_t>(j);
+  const auto  i1 = std::min(i0 + 1, img.rows() - 1);
+  const auto  j1 = std::min(j0 + 1, img.columns() - 1);
+  const float fi = static_cast<float>(i - i0);
+  const float fj = static_cast<float>(j - j0);
+
+  const float top = img(i0, j0) + fj * (img(i0, j1) - img(i0, j0));
+  const float bot = img(i1, j0) + fj * (img(i1, j1) - img(i1, j0));
+  return top + fi * (bot - top);
+}
+
+}  // namespace detail
+
+/**
+ * \brief  Sample a grid of cells of a quadrilateral
+ *
+ * Cell (r, c) is the mean of samples x samples bilinear interpolations on
+ * the central window fraction of the cell, mapped through the homography of
+ * the unit square onto corners. Along a row of cells the numerators and the
+ * denominator of the homography advance by constant increments, so each
+ * sample costs one division.
+ *
+ * Degenerate quadrilaterals, see Homography::valid(), give an empty result.
+ *
+ * \param[in]  img      Greyscale image
+ * \param[in]  corners  Corners of the grid, see homography()
+ * \param[in]  rows     Number of cell rows
+ * \param[in]  columns  Number of cell columns
+ * \param[in]  samples  Samples per cell and dimension
+ * \param[in]  window   Fraction of the cell size covered by the samples
+ */
+template <class ImageT>
+blaze::DynamicMatrix<uint8_t> sample(const ImageT &               img,
+                                     const std::array<Point, 4> & corners,
+                                     std::size_t                  rows,
+                                     std::size_t                  columns,
+                                     std::size_t                  samples = 2,
+                                     double window = 0.5) {
+  auto ret = blaze::DynamicMatrix<uint8_t>(rows, columns);
+  if (rows == 0 || columns == 0 || img.rows() == 0 || img.columns() == 0) {
+    return ret;
+  }
+
+  const auto H = homography(corners);
+  if (!H.valid()) { return blaze::DynamicMatrix<uint8_t>(); }
+
+  const double du    = 1. / columns;
+  const double dv    = 1. / rows;
+  const float  scale = 1.F / static_cast<float>(samples * samples);
+
+  // Offsets of the samples from the corner of a cell, in cells
+  auto offsets = std::vector<double>(samples);
+  for (std::size_t s = 0; s < samples; ++s) {
+    offsets[s] = 0.5 + window * ((s + 0.5) / samples - 0.5);
+  }
+
+  auto sums = std::vector<float>(columns);
+  for (std::size_t r = 0; r < rows; ++r) {
+    std::fill(sums.begin(), sums.end(), 0.F);
+    for (const double sv : offsets) {
+      const double v = (r + sv) * dv;
+      for (const double su : offsets) {
+        const double u = su * du;
+        double       X = H.x[0] * u + H.x[1] * v + H.x[2];
+        double       Y = H.y[0] * u + H.y[1] * v + H.y[2];
+        double       W = H.w[0] * u + H.w[1] * v + H.w[2];
+        for (std::size_t c = 0; c < columns; ++c) {
+          const double inv = 1. / W;
+          sums[c] += detail::bilinear(img, Y * inv, X * inv);
+          X += H.x[0] * du;
+          Y += H.y[0] * du;
+          W += H.w[0] * du;
+        }
+      }
+    }
+    for (std::size_t c = 0; c < columns; ++c) {
+      ret(r, c) = static_cast<uint8_t>(std::lround(sums[c] * scale));
+    }
+  }
+  return ret;
+}
+
+template <class ImageT>
+blaze::DynamicMatrix<uint8_t> sample(const ImageT &    img,
+                                     const Rectangle & rectangle,
+                                     std::size_t       rows,
+                                     std::size_t       columns,
+                                     std::size_t       samples = 2,
+                                     double            window  = 0.5) {
+  return sample(img, rectangle.points, rows, columns, samples, window);
+}
+
 }  // namespace geometry
 }  // namespace balken
 #endif
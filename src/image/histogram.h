@@ -10,31 +10,184 @@
 #define BALKEN__HISTOGRAM_H__INCLUDED
 
 #include <util.h>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <limits>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+#include "arena.h"
+#include "lut.h"
+#include "parallel.h"
 #include "view.h"
 
 namespace balken {
 namespace histogram {
+
+/**
+ * Number of pixels per value of an 8 bit image
+ */
+using Counts = std::array<uint32_t, 256>;
+
 namespace detail {
 
+/**
+ * Number of interleaved counter banks. Consecutive pixels increment
+ * different banks, so runs of equal values do not serialize on one counter.
+ */
+constexpr std::size_t banks = 4;
+
+using Banks = std::array<Counts, banks>;
+
+inline void count_row(const uint8_t * row, std::size_t n, Banks & b) {
+  std::size_t j = 0;
+  for (; j + 8 <= n; j += 8) {
+    uint64_t v;
+    std::memcpy(&v, row + j, sizeof(v));
+    ++b[0][v & 0xFF];
+    ++b[1][(v >> 8) & 0xFF];
+    ++b[2][(v >> 16) & 0xFF];
+    ++b[3][(v >> 24) & 0xFF];
+    ++b[0][(v >> 32) & 0xFF];
+    ++b[1][(v >> 40) & 0xFF];
+    ++b[2][(v >> 48) & 0xFF];
+    ++b[3][v >> 56];
+  }
+  for (; j < n; ++j) { ++b[j % banks][row[j]]; }
+}
+
+using Matrix = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>;
+
+inline void count_rows(const Matrix & img,
+                       std::size_t    i0,
+                       std::size_t    i1,
+                       Banks &        b) {
+  for (std::size_t i = i0; i < i1; ++i) {
+    count_row(&img(i, 0), img.columns(), b);
+  }
+}
+
+// Matrices are counted in place and need no line buffer
+inline void count_rows(const Matrix & img,
+                       std::size_t    i0,
+                       std::size_t    i1,
+                       Banks &        b,
+                       uint8_t *) {
+  count_rows(img, i0, i1, b);
+}
+
+/**
+ * Count the rows [i0, i1) of a view, evaluated one by one into line
+ */
 template <class ImageT>
-auto generate(const ImageT & img) {
-  auto hist =
-    std::array<float,
-               std::numeric_limits<typename ImageT::ElementType>::max() + 1>();
+void count_rows(const ImageT & img,
+                std::size_t    i0,
+                std::size_t    i1,
+                Banks &        b,
+                uint8_t *      line) {
+  const auto columns = img.columns();
+  for (std::size_t i = i0; i < i1; ++i) {
+    view::evaluate(img, line, columns, i, i + 1, 0, columns);
+    count_row(line, columns, b);
+  }
+}
 
-  for (size_t i = 0UL; i < img.rows(); ++i) {
-    for (size_t j = 0UL; j < img.columns(); ++j) { ++hist[img(i, j)]; }
+template <class ImageT>
+void count_rows(const ImageT & img,
+                std::size_t    i0,
+                std::size_t    i1,
+                Banks &        b) {
+  auto line = std::vector<uint8_t>(img.columns());
+  count_rows(img, i0, i1, b, line.data());
+}
+
+inline void merge(const Banks & b, Counts & out) {
+  for (std::size_t v = 0; v < out.size(); ++v) {
+    out[v] += b[0][v] + b[1][v] + b[2][v] + b[3][v];
   }
+}
+
+}  // namespace detail
+
+/**
+ * \brief  Count the pixels per value of an 8 bit image or view
+ */
+template <class ImageT>
+Counts count(const ImageT & img) {
+  static_assert(sizeof(typename ImageT::ElementType) == 1, "8 bit image");
+
+  auto banks = detail::Banks();
+  auto ret   = Counts();
+  if (img.columns() > 0) { detail::count_rows(img, 0, img.rows(), banks); }
+  detail::merge(banks, ret);
+  return ret;
+}
 
-  for (size_t i = 0UL; i < hist.size(); ++i) {
-    hist[i] = hist[i] / (img.columns() * img.rows());
+/**
+ * \brief  Count the pixels per value, the line buffer of views is taken
+ *         from a frame arena
+ */
+template <class ImageT>
+Counts count(const ImageT & img, arena::FrameArena & arena) {
+  static_assert(sizeof(typename ImageT::ElementType) == 1, "8 bit image");
+
+  auto banks = detail::Banks();
+  auto ret   = Counts();
+  if (img.columns() > 0) {
+    auto line = arena.allocate<uint8_t>(img.columns());
+    detail::count_rows(img, 0, img.rows(), banks, line);
   }
+  detail::merge(banks, ret);
+  return ret;
+}
 
-  return hist;
+/**
+ * \brief  Count the pixels per value, with the rows split across a pool
+ */
+template <class ImageT>
+Counts count(const ImageT & img, parallel::ThreadPool & pool) {
+  static_assert(sizeof(typename ImageT::ElementType) == 1, "8 bit image");
+
+  auto       ret = Counts();
+  std::mutex mutex;
+  if (img.columns() == 0) { return ret; }
+  pool.parallel_for(
+    img.rows(),
+    [&](std::size_t begin, std::size_t end) {
+      auto banks = detail::Banks();
+      auto local = Counts();
+      detail::count_rows(img, begin, end, banks);
+      detail::merge(banks, local);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      for (std::size_t v = 0; v < ret.size(); ++v) { ret[v] += local[v]; }
+    },
+    64);
+  return ret;
+}
+
+/**
+ * \brief  Fraction of pixels per value
+ */
+inline std::array<float, 256> normalize(const Counts & counts) {
+  uint64_t total = 0;
+  for (auto c : counts) { total += c; }
+
+  auto ret = std::array<float, 256>();
+  for (std::size_t v = 0; v < counts.size(); ++v) {
+    ret[v] = total ? counts[v] / static_cast<float>(total) : 0.F;
+  }
+  return ret;
+}
+
+namespace detail {
+
+template <class ImageT>
+auto generate(const ImageT & img) {
+  return normalize(count(img));
 }
 
 template <class HistT>
@@ -47,89 +200,54 @@ auto accumulate(HistT & hist) {
 
 namespace views {
 
+/**
+ * Linear contrast stretch of an image to its full value range
+ */
 template <class ImageT>
-class StretchedView : public view::ViewBase<ImageT, StretchedView<ImageT>>
-{
-  using self_t = StretchedView<ImageT>;
-  using base_t = view::ViewBase<ImageT, self_t>;
-
-public:
-  // blaze
-  using ElementType = typename ImageT::ElementType;
-
-public:
-  StretchedView() = delete;
-  StretchedView(const ImageT & img)
-   : base_t(img), _max(blaze::max(img)), _min(blaze::min(img)) {}
-  ~StretchedView() = default;
-
-  // Element Access
-private:
-  constexpr uint8_t normalize(const ElementType & ref) const {
-    auto factor =
-      std::numeric_limits<uint8_t>::max() / static_cast<float>(_max - _min);
-    return static_cast<uint8_t>((ref - _min) * factor);
-  }
-
-public:
-  constexpr uint8_t operator()(size_t i, size_t j) const {
-    return normalize(this->_img(i, j));
-  }
-
-private:
-  const ElementType _max;
-  const ElementType _min;
-};
+using StretchedView = lut::views::LutView<ImageT>;
 
 template <class ImageT>
 auto stretch(const ImageT & img) {
-  return StretchedView<ImageT>(img);
+  return StretchedView<ImageT>(img,
+                               lut::stretch(blaze::min(img), blaze::max(img)));
 }
 
 }  // namespace views
 
-template <class ImageT>
-auto equalize(ImageT & img) {
-  auto hist     = detail::generate(img);
+/**
+ * \brief  Table of the histogram equalization of an image
+ */
+inline lut::Lut equalization(const Counts & counts) {
+  auto hist     = normalize(counts);
   auto cum_hist = detail::accumulate(hist);
-
-  for (size_t i = 0UL; i < img.rows(); ++i) {
-    for (size_t j = 0UL; j < img.columns(); ++j) {
-      img(i, j) =
-        floor(std::numeric_limits<typename ImageT::ElementType>::max() *
-              cum_hist[img(i, j)]);
-    }
+  auto ret      = lut::Lut();
+  for (std::size_t v = 0; v < cum_hist.size(); ++v) {
+    ret[v] = static_cast<uint8_t>(
+      floor(std::numeric_limits<uint8_t>::max() * cum_hist[v]));
   }
-  return img;
+  return ret;
 }
 
-template <class ImageT>
-decltype(auto) stretch(ImageT && img) {
-  const int max = std::numeric_limits<typename ImageT::ElementType>::max();
-
-  auto hist    = detail::generate(img);
-  int  lowest  = static_cast<int>(max);
-  int  highest = 0;
-
-  for (int i = 0; i < static_cast<int>(hist.size()); ++i) {
-    if (hist[i] && (lowest == max)) {
-      lowest  = i;
-      highest = i;
-    } else if (hist[i]) {
-      highest = i;
-    }
-  }
-
-  float factor = static_cast<float>(max) / (highest - lowest);
+/**
+ * \brief  Table of the linear stretch of the occupied values to [0, 255]
+ */
+inline lut::Lut stretching(const Counts & counts) {
+  int lowest  = 0;
+  int highest = static_cast<int>(counts.size()) - 1;
+  while (lowest < highest && !counts[lowest]) { ++lowest; }
+  while (highest > lowest && !counts[highest]) { --highest; }
+  return lut::stretch(static_cast<uint8_t>(lowest),
+                      static_cast<uint8_t>(highest));
+}
 
-  std::cout << lowest << ", " << highest << '\n';
+template <class ImageT>
+auto equalize(ImageT & img) {
+  return lut::transform(img, equalization(count(img)));
+}
 
-  for (size_t i = 0UL; i < img.rows(); ++i) {
-    for (size_t j = 0UL; j < img.columns(); ++j) {
-      img(i, j) = static_cast<uint8_t>((img(i, j) - lowest) * factor);
-    }
-  }
-  return img;
+template <class ImageT>
+decltype(auto) stretch(ImageT && img) {
+  return lut::transform(img, stretching(count(img)));
 }
 
 }  // namespace histogram
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__INTEGRAL_H__INCLUDED
+#define BALKEN__INTEGRAL_H__INCLUDED
+
+// cpp
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+
+// own
+#include "view.h"
+
+namespace balken {
+namespace integral {
+
+/**
+ * Summed-area table of an 8 bit image, optionally also of its squares.
+ *
+ * Entry (i, j) holds the sum over rows [0, i) and columns [0, j), so any
+ * rectangle sum takes four lookups. uint32_t sums are exact for images of
+ * up to 2^24 pixels, use uint64_t beyond that.
+ */
+template <class SumT = uint32_t>
+class IntegralImage
+{
+public:
+  template <class ImageT>
+  explicit IntegralImage(const ImageT & img, bool squares = false)
+   : _sum(img.rows() + 1, img.columns() + 1, 0) {
+    static_assert(sizeof(typename ImageT::ElementType) == 1, "8 bit image");
+
+    const std::size_t rows    = img.rows();
+    const std::size_t columns = img.columns();
+    if (squares) {
+      _squares = blaze::DynamicMatrix<uint64_t, blaze::rowMajor>(
+        rows + 1, columns + 1, 0);
+    }
+
+    // Running sum along the row, then one vectorizable add of the row above.
+    // The running sum is a serial dependency and stays scalar.
+    auto line   = std::vector<uint8_t>(columns);
+    auto row    = std::vector<SumT>(columns + 1, 0);
+    auto row_sq = std::vector<uint64_t>(columns + 1, 0);
+    for (std::size_t i = 0; i < rows; ++i) {
+      view::evaluate(img, line.data(), columns, i, i + 1, 0, columns);
+      for (std::size_t j = 0; j < columns; ++j) {
+        row[j + 1] = row[j] + line[j];
+      }
+      const SumT * above = &_sum(i, 0);
+      SumT *       out   = &_sum(i + 1, 0);
+      for (std::size_t j = 0; j <= columns; ++j) {
+        out[j] = above[j] + row[j];
+      }
+
+      if (squares) {
+        for (std::size_t j = 0; j < columns; ++j) {
+          row_sq[j + 1] = row_sq[j] + uint32_t{line[j]} * line[j];
+        }
+        const uint64_t * above_sq = &_squares(i, 0);
+        uint64_t *       out_sq   = &_squares(i + 1, 0);
+        for (std::size_t j = 0; j <= columns; ++j) {
+          out_sq[j] = above_sq[j] + row_sq[j];
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief  Sum over rows [i0, i1) and columns [j0, j1)
+   */
+  SumT sum(std::size_t i0,
+           std::size_t j0,
+           std::size_t i1,
+           std::size_t j1) const {
+    return _sum(i1, j1) + _sum(i0, j0) - _sum(i0, j1) - _sum(i1, j0);
+  }
+
+  /**
+   * \brief  Sum of squares over rows [i0, i1) and columns [j0, j1), only
+   *         available if built with squares
+   */
+  uint64_t squares(std::size_t i0,
+                   std::size_t j0,
+                   std::size_t i1,
+                   std::size_t j1) const {
+    return _squares(i1, j1) + _squares(i0, j0) - _squares(i0, j1) -
+           _squares(i1, j0);
+  }
+
+  float mean(std::size_t i0,
+             std::size_t j0,
+             std::size_t i1,
+             std::size_t j1) const {
+    return sum(i0, j0, i1, j1) / static_cast<float>((i1 - i0) * (j1 - j0));
+  }
+
+  /**
+   * \brief  Population variance, only available if built with squares
+   */
+  float variance(std::size_t i0,
+                 std::size_t j0,
+                 std::size_t i1,
+                 std::size_t j1) const {
+    const float area = static_cast<float>((i1 - i0) * (j1 - j0));
+    const float m    = sum(i0, j0, i1, j1) / area;
+    return std::max(0.F, squares(i0, j0, i1, j1) / area - m * m);
+  }
+
+  bool has_squares() const { return _squares.rows() > 0; }
+
+  // Dimensions of the image
+  std::size_t rows() const { return _sum.rows() - 1; }
+  std::size_t columns() const { return _sum.columns() - 1; }
+
+private:
+  blaze::DynamicMatrix<SumT, blaze::rowMajor>     _sum;
+  blaze::DynamicMatrix<uint64_t, blaze::rowMajor> _squares;
+};
+
+/**
+ * \brief  Mean over the (2 radius + 1)^2 window of every pixel
+ *
+ * Windows are clipped at the image border, results are rounded.
+ */
+template <class SumT>
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> box(
+  const IntegralImage<SumT> & sums, std::size_t radius) {
+  const std::size_t rows    = sums.rows();
+  const std::size_t columns = sums.columns();
+
+  auto ret = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(rows, columns);
+  for (std::size_t i = 0; i < rows; ++i) {
+    const std::size_t i0 = i > radius ? i - radius : 0;
+    const std::size_t i1 = std::min(rows, i + radius + 1);
+    for (std::size_t j = 0; j < columns; ++j) {
+      const std::size_t j0   = j > radius ? j - radius : 0;
+      const std::size_t j1   = std::min(columns, j + radius + 1);
+      const SumT        area = static_cast<SumT>((i1 - i0) * (j1 - j0));
+
+      ret(i, j) = static_cast<uint8_t>(
+        (sums.sum(i0, j0, i1, j1) + area / 2) / area);
+    }
+  }
+  return ret;
+}
+
+template <class ImageT>
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> box(const ImageT & img,
+                                                   std::size_t    radius) {
+  return box(IntegralImage<>(img), radius);
+}
+
+}  // namespace integral
+}  // namespace balken
+
+#endif
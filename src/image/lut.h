@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__LUT_H__INCLUDED
+#define BALKEN__LUT_H__INCLUDED
+
+// cpp
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// own
+#include "simd.h"
+#include "view.h"
+
+namespace balken {
+namespace lut {
+
+/**
+ * Pixel value transform of 8 bit images as a table of 256 entries.
+ */
+class Lut
+{
+public:
+  using Table = std::array<uint8_t, 256>;
+
+public:
+  /**
+   * Identity transform
+   */
+  Lut() {
+    for (std::size_t v = 0; v < _table.size(); ++v) {
+      _table[v] = static_cast<uint8_t>(v);
+    }
+  }
+  explicit Lut(const Table & table) : _table{table} {}
+
+  uint8_t   operator[](uint8_t v) const { return _table[v]; }
+  uint8_t & operator[](uint8_t v) { return _table[v]; }
+
+  const uint8_t * data() const { return _table.data(); }
+
+  /**
+   * \brief  Transform applying this table first and next afterwards
+   */
+  Lut then(const Lut & next) const {
+    auto ret = Lut();
+    simd::lut_row(next.data(), _table.data(), ret._table.data(), 256);
+    return ret;
+  }
+
+  /**
+   * \brief  dst[j] = table[src[j]] for j in [0, n), src may equal dst
+   */
+  void apply(const uint8_t * src, uint8_t * dst, std::size_t n) const {
+    simd::lut_row(_table.data(), src, dst, n);
+  }
+
+private:
+  Table _table;
+};
+
+/**
+ * \brief  Linear contrast stretch mapping [min, max] to [0, 255]
+ *
+ * Values below min map to 0, values above max to 255. A constant image
+ * (min == max) maps to 0.
+ */
+inline Lut stretch(uint8_t min, uint8_t max) {
+  auto ret = Lut();
+  auto factor =
+    std::numeric_limits<uint8_t>::max() / static_cast<float>(max - min);
+  for (int v = 0; v < 256; ++v) {
+    if (max == min || v < min) {
+      ret[v] = 0;
+    } else if (v > max) {
+      ret[v] = std::numeric_limits<uint8_t>::max();
+    } else {
+      ret[v] = static_cast<uint8_t>((v - min) * factor);
+    }
+  }
+  return ret;
+}
+
+/**
+ * \brief  Binarization, values above threshold map to 255, all others to 0
+ */
+inline Lut threshold(uint8_t threshold) {
+  auto ret = Lut();
+  for (int v = 0; v < 256; ++v) {
+    ret[v] = v > threshold ? std::numeric_limits<uint8_t>::max() : 0;
+  }
+  return ret;
+}
+
+/**
+ * \brief  Apply a table to every pixel of a row-major matrix in place
+ */
+template <class ImageT>
+ImageT & transform(ImageT & img, const Lut & lut) {
+  for (std::size_t i = 0; i < img.rows(); ++i) {
+    lut.apply(&img(i, 0), &img(i, 0), img.columns());
+  }
+  return img;
+}
+
+namespace views {
+
+/**
+ * Image with a table applied to every pixel
+ */
+template <class ImageT>
+class LutView : public view::ViewBase<ImageT, LutView<ImageT>>
+{
+  using self_t = LutView<ImageT>;
+  using base_t = view::ViewBase<ImageT, self_t>;
+
+public:
+  using ElementType = uint8_t;
+
+public:
+  LutView(const ImageT & img, const Lut & lut) : base_t(img), _lut{lut} {}
+
+public:
+  uint8_t view_element(std::size_t i, std::size_t j) const {
+    return _lut[this->_img(i, j)];
+  }
+
+  /**
+   * Evaluate a tile of the view, see view::evaluate.
+   */
+  void materialize_tile(uint8_t *   dst,
+                        std::size_t stride,
+                        std::size_t i0,
+                        std::size_t i1,
+                        std::size_t j0,
+                        std::size_t j1) const {
+    view::evaluate(this->_img, dst, stride, i0, i1, j0, j1);
+    for (std::size_t i = i0; i < i1; ++i) {
+      uint8_t * row = dst + (i - i0) * stride;
+      _lut.apply(row, row, j1 - j0);
+    }
+  }
+
+  const ImageT & image() const { return this->_img; }
+  const Lut &    lut() const { return _lut; }
+
+private:
+  const Lut _lut;
+};
+
+/**
+ * \brief  Apply a table lazily, tables applied to a LutView are fused
+ */
+template <class ImageT>
+LutView<ImageT> apply(const ImageT & img, const Lut & lut) {
+  return LutView<ImageT>(img, lut);
+}
+
+template <class ImageT>
+LutView<ImageT> apply(const LutView<ImageT> & img, const Lut & lut) {
+  return LutView<ImageT>(img.image(), img.lut().then(lut));
+}
+
+}  // namespace views
+}  // namespace lut
+}  // namespace balken
+
+#endif
@@ -9,20 +9,380 @@
 #ifndef BALKEN__MORPH_H__INCLUDED
 #define BALKEN__MORPH_H__INCLUDED
 
+#include <algorithm>
 #include <cstdint>
 #include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <blaze/math/DynamicMatrix.h>
+
+#include "arena.h"
+#include "simd.h"
 #include "view.h"
 
 namespace balken {
 namespace morph {
 
+/**
+ * Rectangular structuring element of only ones.
+ *
+ * Behaves like a kernel matrix but is always decomposed into a row and a
+ * column pass by erode/dilate.
+ */
+class RectangularStruc
+{
+public:
+  using ElementType = uint8_t;
+
+public:
+  constexpr RectangularStruc(std::size_t rows, std::size_t columns)
+   : _rows{rows}, _columns{columns} {}
+
+  constexpr ElementType operator()(std::size_t, std::size_t) const {
+    return 1;
+  }
+
+  constexpr std::size_t rows() const { return _rows; }
+  constexpr std::size_t columns() const { return _columns; }
+
+private:
+  const std::size_t _rows;
+  const std::size_t _columns;
+};
+
+constexpr RectangularStruc rectangle(std::size_t rows, std::size_t columns) {
+  return RectangularStruc(rows, columns);
+}
+
+namespace detail {
+
+struct min_op
+{
+  constexpr uint8_t operator()(uint8_t a, uint8_t b) const {
+    return a < b ? a : b;
+  }
+};
+
+struct max_op
+{
+  constexpr uint8_t operator()(uint8_t a, uint8_t b) const {
+    return a > b ? a : b;
+  }
+};
+
+/**
+ * Check if all elements of a kernel are set, i.e. the kernel is separable
+ * into a row and a column of ones.
+ */
+template <class KernelT>
+bool is_rectangular(const KernelT & kernel) {
+  for (std::size_t h = 0; h < kernel.rows(); ++h) {
+    for (std::size_t w = 0; w < kernel.columns(); ++w) {
+      if (kernel(h, w) != 1) { return false; }
+    }
+  }
+  return true;
+}
+
+inline bool is_rectangular(const RectangularStruc &) { return true; }
+
+/**
+ * Views and adaptors refer to their structuring element, rectangles are
+ * held by value so that views on morph::rectangle() temporaries stay valid
+ */
+template <class StrucT>
+struct struc_ref
+{
+  using type = const StrucT &;
+};
+
+template <>
+struct struc_ref<RectangularStruc>
+{
+  using type = const RectangularStruc;
+};
+
+/**
+ * Running min/max over a line of n elements with window size k
+ * (van Herk / Gil-Werman).
+ *
+ * The line is split into blocks of k elements. Every window of size k spans
+ * the suffix of one block and the prefix of the next, so each output needs a
+ * single op() regardless of k. out[c] is written for c in [k/2, n - k/2).
+ */
+template <class OpT>
+void van_herk_line(const uint8_t * in,
+                   uint8_t *       out,
+                   std::size_t     n,
+                   std::size_t     k,
+                   uint8_t *       suffix,
+                   OpT             op) {
+  const std::size_t half = k / 2;
+  for (std::size_t b0 = 0; b0 + k <= n; b0 += k) {
+    const std::size_t b1 = b0 + k;
+
+    suffix[k - 1] = in[b1 - 1];
+    for (std::size_t r = k - 1; r > 0; --r) {
+      suffix[r - 1] = op(in[b0 + r - 1], suffix[r]);
+    }
+
+    out[b0 + half] = suffix[0];
+    uint8_t prefix = 0;
+    for (std::size_t s = b0 + 1; s < b1 && s + k <= n; ++s) {
+      prefix = (s == b0 + 1) ? in[b1] : op(prefix, in[s + k - 1]);
+      out[s + half] = op(suffix[s - b0], prefix);
+    }
+  }
+}
+
+/**
+ * Erosion/Dilation with a rectangular structuring element of ones in
+ * constant time per pixel, done as a horizontal and a vertical pass.
+ *
+ * The vertical pass runs over whole rows so it stays cache friendly and only
+ * keeps k + 1 rows of intermediate state. Pixels whose neighborhood leaves
+ * the image are set to 0. The result is written to ret, which has the
+ * dimensions of img, intermediates are drawn from arena.
+ */
+template <class ImageT, class OpT, class OutT>
+void rectangular(const ImageT &      img,
+                 std::size_t         k_h,
+                 std::size_t         k_w,
+                 OpT                 op,
+                 OutT &              ret,
+                 arena::FrameArena & arena) {
+  const std::size_t rows    = img.rows();
+  const std::size_t columns = img.columns();
+
+  for (std::size_t i = 0; i < rows; ++i) {
+    std::fill_n(&ret(i, 0), columns, 0);
+  }
+  if (k_h > rows || k_w > columns) { return; }
+
+  // Horizontal pass
+  auto tmp    = arena.matrix<uint8_t>(rows, columns);
+  auto line   = arena.allocate<uint8_t>(columns);
+  auto suffix = arena.allocate<uint8_t>(k_w);
+  for (std::size_t i = 0; i < rows; ++i) {
+    for (std::size_t j = 0; j < columns; ++j) { line[j] = img(i, j); }
+    van_herk_line(line, &tmp(i, 0), columns, k_w, suffix, op);
+  }
+
+  // Vertical pass, a block of k_h suffix rows plus one running prefix row
+  const std::size_t half_h   = k_h / 2;
+  const std::size_t half_w   = k_w / 2;
+  const std::size_t first    = half_w;
+  const std::size_t width    = columns - 2 * half_w;
+  auto              suf_rows = arena.allocate<uint8_t>(k_h * width);
+  auto              prefix   = arena.allocate<uint8_t>(width);
+
+  for (std::size_t b0 = 0; b0 + k_h <= rows; b0 += k_h) {
+    const std::size_t b1 = b0 + k_h;
+
+    std::copy_n(&tmp(b1 - 1, first), width, &suf_rows[(k_h - 1) * width]);
+    for (std::size_t r = k_h - 1; r > 0; --r) {
+      const uint8_t * in  = &tmp(b0 + r - 1, first);
+      const uint8_t * nxt = &suf_rows[r * width];
+      uint8_t *       cur = &suf_rows[(r - 1) * width];
+      for (std::size_t j = 0; j < width; ++j) { cur[j] = op(in[j], nxt[j]); }
+    }
+
+    std::copy_n(suf_rows, width, &ret(b0 + half_h, first));
+    for (std::size_t s = b0 + 1; s < b1 && s + k_h <= rows; ++s) {
+      const uint8_t * in = &tmp(s + k_h - 1, first);
+      if (s == b0 + 1) {
+        std::copy_n(in, width, prefix);
+      } else {
+        for (std::size_t j = 0; j < width; ++j) {
+          prefix[j] = op(prefix[j], in[j]);
+        }
+      }
+      const uint8_t * suf = &suf_rows[(s - b0) * width];
+      uint8_t *       out = &ret(s + half_h, first);
+      for (std::size_t j = 0; j < width; ++j) {
+        out[j] = op(suf[j], prefix[j]);
+      }
+    }
+  }
+}
+
+template <class ImageT, class OpT>
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> rectangular(
+  const ImageT & img, std::size_t k_h, std::size_t k_w, OpT op) {
+  auto ret =
+    blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(img.rows(), img.columns());
+  arena::FrameArena scratch;
+  rectangular(img, k_h, k_w, op, ret, scratch);
+  return ret;
+}
+
+/**
+ * Erosion/Dilation with an arbitrary structuring element, op folds the
+ * input under the set kernel elements starting from init. Pixels whose
+ * neighborhood leaves the image are left untouched.
+ */
+template <class ImageT, class KernelT, class OpT, class OutT>
+void kernel_fold(const ImageT &  img,
+                 const KernelT & kernel,
+                 OpT             op,
+                 uint8_t         init,
+                 OutT &          ret) {
+  const size_t half_h = kernel.rows() / 2;
+  const size_t half_w = kernel.columns() / 2;
+
+  for (size_t i = 0; i < img.rows() - kernel.rows(); ++i) {
+    for (size_t j = 0; j < img.columns() - kernel.columns(); ++j) {
+      uint8_t acc = init;
+      for (size_t h = 0; h < kernel.rows(); ++h) {
+        for (size_t w = 0; w < kernel.columns(); ++w) {
+          if (kernel(h, w) == 1) { acc = op(acc, img(i + h, j + w)); }
+        }
+      }
+      ret(i + half_h, j + half_w) = acc;
+    }
+  }
+}
+
+using Matrix = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>;
+
+/**
+ * Window [r0, r1) x [c0, c1) of an image as pointer and row stride. Matrices
+ * are read in place, views are evaluated into buffer.
+ */
+inline std::pair<const uint8_t *, std::size_t> window(const Matrix & img,
+                                                      std::size_t    r0,
+                                                      std::size_t,
+                                                      std::size_t c0,
+                                                      std::size_t,
+                                                      Matrix &) {
+  return {&img(r0, c0), img.spacing()};
+}
+
+template <class ImageT>
+std::pair<const uint8_t *, std::size_t> window(const ImageT & img,
+                                               std::size_t    r0,
+                                               std::size_t    r1,
+                                               std::size_t    c0,
+                                               std::size_t    c1,
+                                               Matrix &       buffer) {
+  buffer.resize(r1 - r0, c1 - c0, false);
+  view::evaluate(img, buffer.data(), buffer.spacing(), r0, r1, c0, c1);
+  return {buffer.data(), buffer.spacing()};
+}
+
+/**
+ * Evaluate rows [i0, i1) and columns [j0, j1) of an eroded or dilated view.
+ *
+ * Every set element of the structuring element is applied to a whole row of
+ * the tile at once using the vectorized row kernel RowOpT. The input is read
+ * through window(), including a halo of the size of the structuring element.
+ * The border handling matches ErodedView/DilatedView::view_element.
+ */
+template <class ImageT, class StrucT, class RowOpT>
+void neighborhood(const ImageT & img,
+                  const StrucT & struc,
+                  uint8_t        init,
+                  RowOpT         row_op,
+                  uint8_t *      dst,
+                  std::size_t    stride,
+                  std::size_t    i0,
+                  std::size_t    i1,
+                  std::size_t    j0,
+                  std::size_t    j1,
+                  Matrix &       buffer) {
+  const std::size_t half_h = struc.rows() / 2;
+  const std::size_t half_w = struc.columns() / 2;
+
+  // Pixels in [first_*, last_*) have their whole neighborhood in the image
+  const std::size_t rows    = img.rows();
+  const std::size_t columns = img.columns();
+  const std::size_t first_i = half_h + 1;
+  const std::size_t first_j = half_w + 1;
+  const std::size_t last_i  = rows > first_i ? rows - first_i : 0;
+  const std::size_t last_j  = columns > first_j ? columns - first_j : 0;
+
+  const std::size_t ti0 = std::max(i0, first_i);
+  const std::size_t ti1 = std::min(i1, last_i);
+  const std::size_t tj0 = std::max(j0, first_j);
+  const std::size_t tj1 = std::min(j1, last_j);
+  const bool        any = ti0 < ti1 && tj0 < tj1;
+
+  for (std::size_t i = i0; i < i1; ++i) {
+    uint8_t * row = dst + (i - i0) * stride;
+    if (!any || i < ti0 || i >= ti1) {
+      std::fill_n(row, j1 - j0, 0);
+    } else {
+      std::fill_n(row, tj0 - j0, 0);
+      std::fill_n(row + (tj1 - j0), j1 - tj1, 0);
+    }
+  }
+  if (!any) { return; }
+
+  auto taps = std::vector<std::pair<std::size_t, std::size_t>>();
+  for (std::size_t h = 0; h < struc.rows(); ++h) {
+    for (std::size_t w = 0; w < struc.columns(); ++w) {
+      if (struc(h, w) == 1) { taps.emplace_back(h, w); }
+    }
+  }
+
+  const std::size_t r0  = ti0 - half_h;
+  const std::size_t c0  = tj0 - half_w;
+  const auto        src = window(img,
+                          r0,
+                          ti1 + struc.rows() - 1 - half_h,
+                          c0,
+                          tj1 + struc.columns() - 1 - half_w,
+                          buffer);
+
+  const std::size_t width = tj1 - tj0;
+  for (std::size_t i = ti0; i < ti1; ++i) {
+    uint8_t * out = dst + (i - i0) * stride + (tj0 - j0);
+    std::fill_n(out, width, init);
+    for (const auto & tap : taps) {
+      row_op(out,
+             src.first + (i - ti0 + tap.first) * src.second + tap.second,
+             width);
+    }
+  }
+}
+
+/**
+ * Materialize an eroded or dilated view as a whole.
+ */
+template <class ImageT, class StrucT, class RowOpT>
+Matrix neighborhood(const ImageT & img,
+                    const StrucT & struc,
+                    uint8_t        init,
+                    RowOpT         row_op) {
+  auto ret    = Matrix(img.rows(), img.columns());
+  auto buffer = Matrix();
+  if (img.rows() > 0 && img.columns() > 0) {
+    neighborhood(img,
+                 struc,
+                 init,
+                 row_op,
+                 ret.data(),
+                 ret.spacing(),
+                 0,
+                 img.rows(),
+                 0,
+                 img.columns(),
+                 buffer);
+  }
+  return ret;
+}
+
+}  // namespace detail
+
 namespace adaptors {
 
 template <class StrucT>
 struct dilate_options
 {
   explicit dilate_options(const StrucT & kernel) : kernel(kernel) {}
-  const StrucT & kernel;
+  typename detail::struc_ref<StrucT>::type kernel;
 };
 
 template <class StrucT>
@@ -34,7 +394,7 @@ template <class StrucT>
 struct erode_options
 {
   explicit erode_options(const StrucT & kernel) : kernel(kernel) {}
-  const StrucT & kernel;
+  typename detail::struc_ref<StrucT>::type kernel;
 };
 
 template <class StrucT>
@@ -85,10 +445,44 @@ public:
     return min;
   }
 
+  /**
+   * Evaluate the whole view at once with vectorized row kernels.
+   */
+  blaze::DynamicMatrix<uint8_t, blaze::rowMajor> materialize() const {
+    return detail::neighborhood(this->_img,
+                                _struc,
+                                std::numeric_limits<uint8_t>::max(),
+                                simd::min_row);
+  }
+
+  /**
+   * Evaluate a tile of the view, see view::evaluate.
+   */
+  void materialize_tile(uint8_t *   dst,
+                        std::size_t stride,
+                        std::size_t i0,
+                        std::size_t i1,
+                        std::size_t j0,
+                        std::size_t j1) const {
+    // One buffer per thread and view type for the input tile with its halo
+    static thread_local detail::Matrix buffer;
+    detail::neighborhood(this->_img,
+                         _struc,
+                         std::numeric_limits<uint8_t>::max(),
+                         simd::min_row,
+                         dst,
+                         stride,
+                         i0,
+                         i1,
+                         j0,
+                         j1,
+                         buffer);
+  }
+
 private:
-  const StrucT &    _struc;
-  const std::size_t _floor_half_w;
-  const std::size_t _floor_half_h;
+  typename detail::struc_ref<StrucT>::type _struc;
+  const std::size_t                        _floor_half_w;
+  const std::size_t                        _floor_half_h;
 };
 
 template <class ImageT, class StrucT>
@@ -129,23 +523,94 @@ public:
     return max;
   }
 
+  /**
+   * Evaluate the whole view at once with vectorized row kernels.
+   */
+  blaze::DynamicMatrix<uint8_t, blaze::rowMajor> materialize() const {
+    return detail::neighborhood(this->_img,
+                                _struc,
+                                std::numeric_limits<uint8_t>::min(),
+                                simd::max_row);
+  }
+
+  /**
+   * Evaluate a tile of the view, see view::evaluate.
+   */
+  void materialize_tile(uint8_t *   dst,
+                        std::size_t stride,
+                        std::size_t i0,
+                        std::size_t i1,
+                        std::size_t j0,
+                        std::size_t j1) const {
+    // One buffer per thread and view type for the input tile with its halo
+    static thread_local detail::Matrix buffer;
+    detail::neighborhood(this->_img,
+                         _struc,
+                         std::numeric_limits<uint8_t>::min(),
+                         simd::max_row,
+                         dst,
+                         stride,
+                         i0,
+                         i1,
+                         j0,
+                         j1,
+                         buffer);
+  }
+
 private:
-  const StrucT &    _struc;
-  const std::size_t _floor_half_w;
-  const std::size_t _floor_half_h;
+  typename detail::struc_ref<StrucT>::type _struc;
+  const std::size_t                        _floor_half_w;
+  const std::size_t                        _floor_half_h;
 };
 
+}  // namespace views
+
+namespace detail {
+
+/**
+ * Input of a neighborhood view, other neighborhood views are cached
+ * for as many rows as the structuring element has.
+ */
+template <class ImageT, bool = view::is_neighborhood<ImageT>::value>
+struct input
+{
+  using type = ImageT;
+  static const ImageT & wrap(const ImageT & img, std::size_t) { return img; }
+};
+
+template <class ImageT>
+struct input<ImageT, true>
+{
+  using type = view::CachedView<ImageT>;
+  static type wrap(const ImageT & img, std::size_t rows) {
+    return view::cache(img, rows);
+  }
+};
+
+}  // namespace detail
+
+namespace views {
+
 /**
  * View Constructor Wrappers
  */
 template <class ImageT, class StrucT>
 decltype(auto) dilate(const ImageT & img, const StrucT & struc) {
-  return DilatedView<ImageT, StrucT>(img, struc);
+  using input_t = detail::input<ImageT>;
+  return DilatedView<typename input_t::type, StrucT>(
+    input_t::wrap(img, struc.rows()), struc);
 }
 
 template <class ImageT, class StrucT>
 decltype(auto) erode(const ImageT & img, const StrucT & struc) {
-  return ErodedView<ImageT, StrucT>(img, struc);
+  using input_t = detail::input<ImageT>;
+  return ErodedView<typename input_t::type, StrucT>(
+    input_t::wrap(img, struc.rows()), struc);
+}
+
+template <class ViewT>
+decltype(auto) materialize(const ViewT & view) {
+  return view.materialize();
 }
 
 template <class LeftImageT, class RightImageT>
@@ -153,6 +618,25 @@ RightImageT & operator>>(LeftImageT & l, RightImageT & r) {
   return r;
 }
 }  // namespace views
+}  // namespace morph
+
+namespace view {
+
+template <class ImageT, class StrucT>
+struct is_neighborhood<morph::views::ErodedView<ImageT, StrucT>>
+  : std::true_type
+{
+};
+
+template <class ImageT, class StrucT>
+struct is_neighborhood<morph::views::DilatedView<ImageT, StrucT>>
+  : std::true_type
+{
+};
+
+}  // namespace view
+
+namespace morph {
 
 /**
  * Free Functions
@@ -165,25 +649,14 @@ blaze::DynamicMatrix<uint8_t, blaze::rowMajor> erode(const ImageT &  img,
   assert(kernel.rows() % 2 != 0);
   assert(kernel.columns() % 2 != 0);
 
+  if (detail::is_rectangular(kernel)) {
+    return detail::rectangular(
+      img, kernel.rows(), kernel.columns(), detail::min_op());
+  }
+
   auto ret = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(
     img.rows(), img.columns(), 0UL);
-
-  size_t floor_half_h = floor(kernel.rows() / 2);
-  size_t floor_half_w = floor(kernel.columns() / 2);
-
-  for (size_t i = 0; i < img.rows() - kernel.rows(); ++i) {
-    for (size_t j = 0; j < img.columns() - kernel.columns(); ++j) {
-      uint8_t min = 255;
-      for (size_t h = 0; h < kernel.rows(); ++h) {
-        for (size_t w = 0; w < kernel.rows(); ++w) {
-          if ((kernel(h, w) == 1) && (img(i + h, j + w) < min)) {
-            min = img(i + h, j + w);
-          }
-        }
-      }
-      ret(i + floor_half_h, j + floor_half_w) = min;
-    }
-  }
+  detail::kernel_fold(img, kernel, detail::min_op(), 255, ret);
   return ret;
 }
 
@@ -194,25 +667,14 @@ blaze::DynamicMatrix<uint8_t, blaze::rowMajor> dilate(const ImageT &  img,
   assert(kernel.rows() % 2 != 0);
   assert(kernel.columns() % 2 != 0);
 
+  if (detail::is_rectangular(kernel)) {
+    return detail::rectangular(
+      img, kernel.rows(), kernel.columns(), detail::max_op());
+  }
+
   auto ret = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(
     img.rows(), img.columns(), 0UL);
-
-  size_t floor_half_h = floor(kernel.rows() / 2);
-  size_t floor_half_w = floor(kernel.columns() / 2);
-
-  for (size_t i = 0; i < img.rows() - kernel.rows(); ++i) {
-    for (size_t j = 0; j < img.columns() - kernel.columns(); ++j) {
-      uint8_t max{0};
-      for (size_t h = 0; h < kernel.rows(); ++h) {
-        for (size_t w = 0; w < kernel.rows(); ++w) {
-          if ((kernel(h, w) == 1) && (img(i + h, j + w) > max)) {
-            max = img(i + h, j + w);
-          }
-        }
-      }
-      ret(i + floor_half_h, j + floor_half_w) = max;
-    }
-  }
+  detail::kernel_fold(img, kernel, detail::max_op(), 0, ret);
   return ret;
 }
 
@@ -226,18 +688,71 @@ auto close(const ImageT & img, const KernelT & kernel) {
   return erode(dilate(img, kernel), kernel);
 }
 
+/**
+ * Free functions allocating the result and all intermediates from a frame
+ * arena, valid until the arena is reset
+ */
+
+template <class ImageT, class KernelT>
+arena::Matrix<uint8_t> erode(const ImageT &      img,
+                             const KernelT &     kernel,
+                             arena::FrameArena & arena) {
+  assert(kernel.rows() % 2 != 0);
+  assert(kernel.columns() % 2 != 0);
+
+  auto ret = arena.matrix<uint8_t>(img.rows(), img.columns());
+  if (detail::is_rectangular(kernel)) {
+    detail::rectangular(
+      img, kernel.rows(), kernel.columns(), detail::min_op(), ret, arena);
+  } else {
+    std::fill_n(ret.data(), img.rows() * img.columns(), 0);
+    detail::kernel_fold(img, kernel, detail::min_op(), 255, ret);
+  }
+  return ret;
+}
+
+template <class ImageT, class KernelT>
+arena::Matrix<uint8_t> dilate(const ImageT &      img,
+                              const KernelT &     kernel,
+                              arena::FrameArena & arena) {
+  assert(kernel.rows() % 2 != 0);
+  assert(kernel.columns() % 2 != 0);
+
+  auto ret = arena.matrix<uint8_t>(img.rows(), img.columns());
+  if (detail::is_rectangular(kernel)) {
+    detail::rectangular(
+      img, kernel.rows(), kernel.columns(), detail::max_op(), ret, arena);
+  } else {
+    std::fill_n(ret.data(), img.rows() * img.columns(), 0);
+    detail::kernel_fold(img, kernel, detail::max_op(), 0, ret);
+  }
+  return ret;
+}
+
+template <class ImageT, class KernelT>
+arena::Matrix<uint8_t> open(const ImageT &      img,
+                            const KernelT &     kernel,
+                            arena::FrameArena & arena) {
+  return dilate(erode(img, kernel, arena), kernel, arena);
+}
+
+template <class ImageT, class KernelT>
+arena::Matrix<uint8_t> close(const ImageT &      img,
+                             const KernelT &     kernel,
+                             arena::FrameArena & arena) {
+  return erode(dilate(img, kernel, arena), kernel, arena);
+}
+
 namespace adaptors {
 
 template <class ImageT, class StrucT>
-constexpr views::DilatedView<ImageT, StrucT> operator|(
-  const ImageT & img, dilate_options<StrucT> d) {
-  return views::DilatedView<ImageT, StrucT>(img, d.kernel);
+decltype(auto) operator|(const ImageT & img, dilate_options<StrucT> d) {
+  return views::dilate(img, d.kernel);
 }
 
 template <class ImageT, class StrucT>
-constexpr views::ErodedView<ImageT, StrucT> operator|(
-  const ImageT & img, erode_options<StrucT> d) {
-  return views::ErodedView<ImageT, StrucT>(img, d.kernel);
+decltype(auto) operator|(const ImageT & img, erode_options<StrucT> d) {
+  return views::erode(img, d.kernel);
 }
 
 }  // namespace adaptors
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__PIPELINE_H__INCLUDED
+#define BALKEN__PIPELINE_H__INCLUDED
+
+// cpp
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+
+// own
+#include "lut.h"
+#include "morph.h"
+#include "simd.h"
+
+namespace balken {
+namespace pipeline {
+namespace detail {
+
+/**
+ * Ring buffer holding the last n rows of a stage
+ */
+class RowRing
+{
+public:
+  void resize(std::size_t n, std::size_t columns) {
+    _n       = n;
+    _columns = columns;
+    _data.resize(n * columns);
+  }
+
+  uint8_t *       operator[](std::size_t i) { return &_data[slot(i)]; }
+  const uint8_t * operator[](std::size_t i) const { return &_data[slot(i)]; }
+
+private:
+  std::size_t slot(std::size_t i) const { return (i % _n) * _columns; }
+
+private:
+  std::size_t          _n{0};
+  std::size_t          _columns{0};
+  std::vector<uint8_t> _data;
+};
+
+}  // namespace detail
+
+/**
+ * Fused bottom-hat detection pipeline
+ *
+ * Computes dilate(binarize(close(s) - s, threshold)) for the contrast
+ * stretched image s in a single pass over the rows of the input. Closing and
+ * dilation use rectangular structuring elements of odd size, borders are
+ * handled like morph::close and morph::dilate. Only a few rows per stage are
+ * kept in ring buffers, which are reused between frames.
+ */
+class BottomHat
+{
+public:
+  BottomHat(std::size_t close_rows,
+            std::size_t close_columns,
+            uint8_t     threshold,
+            std::size_t dilate_rows,
+            std::size_t dilate_columns)
+   : _close_h{close_rows / 2},
+     _close_w{close_columns / 2},
+     _dilate_h{dilate_rows / 2},
+     _dilate_w{dilate_columns / 2},
+     _threshold{threshold} {}
+
+  template <class ImageT>
+  blaze::DynamicMatrix<uint8_t> operator()(const ImageT & img) {
+    auto ret = blaze::DynamicMatrix<uint8_t>(img.rows(), img.columns());
+    (*this)(img, ret);
+    return ret;
+  }
+
+  /**
+   * \brief  Run the pipeline on img, writing the binary mask to out
+   *
+   * \param[in]   img  Greyscale image
+   * \param[out]  out  Matrix with the dimensions of img
+   */
+  template <class ImageT, class OutT>
+  void operator()(const ImageT & img, OutT & out) {
+    const auto rows    = img.rows();
+    const auto columns = img.columns();
+    const auto k1      = 2 * _close_h + 1;
+    const auto k2      = 2 * _dilate_h + 1;
+
+    prepare(img);
+    _stretched.resize(k1, columns);
+    _h_dilated.resize(k1, columns);
+    _h_eroded.resize(k1, columns);
+    _h_binary.resize(k2, columns);
+    _row.resize(columns);
+    _line.resize(columns);
+    _suffix.resize(std::max(2 * _close_w, 2 * _dilate_w) + 1);
+
+    // Each stage lags behind the input by the vertical radius of its
+    // structuring element
+    const auto lag_dilate = _close_h;
+    const auto lag_erode  = 2 * _close_h;
+    const auto lag_out    = 2 * _close_h + _dilate_h;
+
+    for (std::size_t t = 0; t < rows + lag_out; ++t) {
+      if (t < rows) {
+        // Stretch and horizontal part of the dilation
+        for (std::size_t j = 0; j < columns; ++j) {
+          _stretched[t][j] = _lut[img(t, j)];
+        }
+        horizontal(_stretched[t], _h_dilated[t], _close_w, max_op());
+      }
+
+      if (t >= lag_dilate && t - lag_dilate < rows) {
+        // Vertical part of the dilation and horizontal part of the erosion
+        const auto r = t - lag_dilate;
+        if (vertical(_h_dilated, r, _close_h, rows, _line.data(), max_op())) {
+          horizontal(_line.data(), _h_eroded[r], _close_w, min_op());
+        } else {
+          std::fill_n(_h_eroded[r], columns, 0);
+        }
+      }
+
+      if (t >= lag_erode && t - lag_erode < rows) {
+        // Vertical part of the erosion, bottom-hat, threshold and horizontal
+        // part of the final dilation
+        const auto r = t - lag_erode;
+        if (!vertical(_h_eroded, r, _close_h, rows, _line.data(), min_op())) {
+          std::fill_n(_line.data(), columns, 0);
+        }
+        const uint8_t * s = _stretched[r];
+        for (std::size_t j = 0; j < columns; ++j) {
+          const int hat = _line[j] - s[j];
+          _row[j]       = hat > _threshold ? 255 : 0;
+        }
+        horizontal(_row.data(), _h_binary[r], _dilate_w, max_op());
+      }
+
+      if (t >= lag_out) {
+        // Vertical part of the final dilation
+        const auto r = t - lag_out;
+        if (vertical(_h_binary, r, _dilate_h, rows, _line.data(), max_op())) {
+          for (std::size_t j = 0; j < columns; ++j) { out(r, j) = _line[j]; }
+        } else {
+          for (std::size_t j = 0; j < columns; ++j) { out(r, j) = 0; }
+        }
+      }
+    }
+  }
+
+private:
+  using max_op = morph::detail::max_op;
+  using min_op = morph::detail::min_op;
+
+  /**
+   * Lookup table of the contrast stretch, see histogram::views::stretch
+   */
+  template <class ImageT>
+  void prepare(const ImageT & img) {
+    uint8_t min = std::numeric_limits<uint8_t>::max();
+    uint8_t max = std::numeric_limits<uint8_t>::min();
+    for (std::size_t i = 0; i < img.rows(); ++i) {
+      for (std::size_t j = 0; j < img.columns(); ++j) {
+        min = std::min<uint8_t>(min, img(i, j));
+        max = std::max<uint8_t>(max, img(i, j));
+      }
+    }
+
+    _lut = lut::stretch(min, max);
+  }
+
+  /**
+   * Running min/max over a row, columns within half of the border are 0
+   */
+  template <class OpT>
+  void horizontal(const uint8_t * in,
+                  uint8_t *       out,
+                  std::size_t     half,
+                  OpT             op) {
+    const auto columns = _row.size();
+    const auto k       = 2 * half + 1;
+    if (k > columns) {
+      std::fill_n(out, columns, 0);
+      return;
+    }
+    std::fill_n(out, half, 0);
+    std::fill_n(out + columns - half, half, 0);
+    morph::detail::van_herk_line(in, out, columns, k, _suffix.data(), op);
+  }
+
+  /**
+   * Min/max over rows [r - half, r + half] of a ring. Returns false if
+   * the window leaves the image, i.e. the row is 0.
+   */
+  template <class OpT>
+  bool vertical(const detail::RowRing & ring,
+                std::size_t             r,
+                std::size_t             half,
+                std::size_t             rows,
+                uint8_t *               out,
+                OpT) const {
+    if (r < half || r + half >= rows) { return false; }
+
+    const auto columns = _row.size();
+    std::copy_n(ring[r - half], columns, out);
+    for (std::size_t i = r - half + 1; i <= r + half; ++i) {
+      if (std::is_same<OpT, max_op>::value) {
+        simd::max_row(out, ring[i], columns);
+      } else {
+        simd::min_row(out, ring[i], columns);
+      }
+    }
+    return true;
+  }
+
+private:
+  const std::size_t _close_h;
+  const std::size_t _close_w;
+  const std::size_t _dilate_h;
+  const std::size_t _dilate_w;
+  const uint8_t     _threshold;
+
+  lut::Lut             _lut;
+  detail::RowRing      _stretched;
+  detail::RowRing      _h_dilated;
+  detail::RowRing      _h_eroded;
+  detail::RowRing      _h_binary;
+  std::vector<uint8_t> _row;
+  std::vector<uint8_t> _line;
+  std::vector<uint8_t> _suffix;
+};
+
+}  // namespace pipeline
+}  // namespace balken
+
+#endif
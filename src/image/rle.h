@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__RLE_H__INCLUDED
+#define BALKEN__RLE_H__INCLUDED
+
+// cpp
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+
+namespace balken {
+namespace rle {
+
+/**
+ * Horizontal run of foreground pixels covering columns [begin, end)
+ */
+struct Run
+{
+  int begin;
+  int end;
+};
+
+/**
+ * Binary image stored as sorted, non-overlapping foreground runs per row.
+ *
+ * Foreground pixels read as 255, background as 0, so the image can be used
+ * wherever a binarized view is expected. Rows are built in order by
+ * appending runs and closing each row with end_row().
+ */
+class RunLengthImage
+{
+public:
+  using ElementType = uint8_t;
+
+public:
+  RunLengthImage() = default;
+  RunLengthImage(std::size_t rows, std::size_t columns)
+   : _rows{rows}, _columns{columns}, _offsets{0} {
+    _offsets.reserve(rows + 1);
+  }
+
+  // Building
+  void append(Run run) {
+    assert(run.begin < run.end);
+    assert(_runs.size() == _offsets.back() || _runs.back().end < run.begin);
+    _runs.push_back(run);
+  }
+
+  void end_row() {
+    assert(_offsets.size() <= _rows);
+    _offsets.push_back(_runs.size());
+  }
+
+  // Run Access
+  const Run * begin(std::size_t i) const {
+    return _runs.data() + _offsets[i];
+  }
+  const Run * end(std::size_t i) const {
+    return _runs.data() + _offsets[i + 1];
+  }
+  std::size_t offset(std::size_t i) const { return _offsets[i]; }
+  std::size_t size() const { return _runs.size(); }
+
+  // Element Access
+  ElementType operator()(std::size_t i, std::size_t j) const {
+    const auto col = static_cast<int>(j);
+    auto       run = std::upper_bound(
+      begin(i), end(i), col, [](int c, const Run & r) { return c < r.begin; });
+    if (run == begin(i)) { return 0; }
+    return col < (run - 1)->end ? std::numeric_limits<ElementType>::max()
+                                : 0;
+  }
+
+  // Dimensions
+  std::size_t rows() const { return _rows; }
+  std::size_t columns() const { return _columns; }
+
+private:
+  std::size_t              _rows{0};
+  std::size_t              _columns{0};
+  std::vector<Run>         _runs;
+  std::vector<std::size_t> _offsets{0};
+};
+
+namespace detail {
+
+/**
+ * Union of two sorted run lists, touching runs are joined.
+ */
+inline void unite(const Run *        a,
+                  const Run *        a_end,
+                  const Run *        b,
+                  const Run *        b_end,
+                  std::vector<Run> & out) {
+  out.clear();
+  while (a != a_end || b != b_end) {
+    const Run next =
+      (b == b_end || (a != a_end && a->begin < b->begin)) ? *a++ : *b++;
+    if (!out.empty() && next.begin <= out.back().end) {
+      out.back().end = std::max(out.back().end, next.end);
+    } else {
+      out.push_back(next);
+    }
+  }
+}
+
+}  // namespace detail
+
+/**
+ * \brief  Run-length encode a binary image
+ *
+ * \param[in]  img  Image or view with foreground pixels of value 255
+ * \return     Run-length encoded image
+ */
+template <class ImageT>
+RunLengthImage encode(const ImageT & img) {
+  auto ret = RunLengthImage(img.rows(), img.columns());
+  for (std::size_t i = 0; i < img.rows(); ++i) {
+    int begin = -1;
+    for (std::size_t j = 0; j < img.columns(); ++j) {
+      const bool set = img(i, j) == std::numeric_limits<uint8_t>::max();
+      if (set && begin < 0) {
+        begin = static_cast<int>(j);
+      } else if (!set && begin >= 0) {
+        ret.append(Run{begin, static_cast<int>(j)});
+        begin = -1;
+      }
+    }
+    if (begin >= 0) {
+      ret.append(Run{begin, static_cast<int>(img.columns())});
+    }
+    ret.end_row();
+  }
+  return ret;
+}
+
+/**
+ * \brief  Expand a run-length encoded image to a matrix of 0 and 255
+ */
+inline blaze::DynamicMatrix<uint8_t> decode(const RunLengthImage & img) {
+  auto ret = blaze::DynamicMatrix<uint8_t>(img.rows(), img.columns(), 0);
+  for (std::size_t i = 0; i < img.rows(); ++i) {
+    for (auto run = img.begin(i); run != img.end(i); ++run) {
+      std::fill_n(&ret(i, run->begin),
+                  run->end - run->begin,
+                  std::numeric_limits<uint8_t>::max());
+    }
+  }
+  return ret;
+}
+
+/**
+ * \brief  Dilate by a horizontal segment of odd length
+ *
+ * Every run grows by length / 2 on both sides, overlapping runs are merged.
+ * Pixels outside the image count as background.
+ */
+inline RunLengthImage dilate_horizontal(const RunLengthImage & img,
+                                        std::size_t            length) {
+  const auto half    = static_cast<int>(length / 2);
+  const auto columns = static_cast<int>(img.columns());
+
+  auto ret = RunLengthImage(img.rows(), img.columns());
+  for (std::size_t i = 0; i < img.rows(); ++i) {
+    Run cur{0, -1};
+    for (auto run = img.begin(i); run != img.end(i); ++run) {
+      const Run grown{std::max(0, run->begin - half),
+                      std::min(columns, run->end + half)};
+      if (cur.end < 0) {
+        cur = grown;
+      } else if (grown.begin <= cur.end) {
+        cur.end = grown.end;
+      } else {
+        ret.append(cur);
+        cur = grown;
+      }
+    }
+    if (cur.end >= 0) { ret.append(cur); }
+    ret.end_row();
+  }
+  return ret;
+}
+
+/**
+ * \brief  Dilate by a vertical segment of odd length
+ *
+ * Every output row is the union of the input rows within length / 2.
+ */
+inline RunLengthImage dilate_vertical(const RunLengthImage & img,
+                                      std::size_t            length) {
+  const auto half = length / 2;
+
+  auto ret    = RunLengthImage(img.rows(), img.columns());
+  auto merged = std::vector<Run>();
+  auto tmp    = std::vector<Run>();
+  for (std::size_t i = 0; i < img.rows(); ++i) {
+    const std::size_t first = i < half ? 0 : i - half;
+    const std::size_t last  = std::min(img.rows() - 1, i + half);
+
+    merged.assign(img.begin(first), img.end(first));
+    for (std::size_t r = first + 1; r <= last; ++r) {
+      if (img.begin(r) == img.end(r)) { continue; }
+      detail::unite(merged.data(),
+                    merged.data() + merged.size(),
+                    img.begin(r),
+                    img.end(r),
+                    tmp);
+      std::swap(merged, tmp);
+    }
+    for (const auto & run : merged) { ret.append(run); }
+    ret.end_row();
+  }
+  return ret;
+}
+
+/**
+ * \brief  Dilate by a rectangle of ones with odd dimensions
+ */
+inline RunLengthImage dilate(const RunLengthImage & img,
+                             std::size_t            rows,
+                             std::size_t            columns) {
+  return dilate_vertical(dilate_horizontal(img, columns), rows);
+}
+
+}  // namespace rle
+}  // namespace balken
+
+#endif
@@ -9,13 +9,57 @@
 #ifndef BALKEN__VIEW_H__INCLUDED
 #define BALKEN__VIEW_H__INCLUDED
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace balken {
 namespace view {
 
+/**
+ * Common base of all views, used to detect them
+ */
+struct ViewTag
+{
+};
+
+template <class ImageT>
+using is_view = std::is_base_of<ViewTag, ImageT>;
+
+/**
+ * Views reading a neighborhood of every pixel of their input, specialized
+ * by the view types. A neighborhood view on top of another one gets a
+ * CachedView in between.
+ */
+template <class ImageT>
+struct is_neighborhood : std::false_type
+{
+};
+
+namespace detail {
+
+template <class ImageT>
+auto invalidate(const ImageT & img, int) -> decltype(img.invalidate()) {
+  img.invalidate();
+}
+
+template <class ImageT>
+void invalidate(const ImageT &, long) {}
+
+}  // namespace detail
+
+/**
+ * Base class of lazily evaluated image views.
+ *
+ * Images are referenced, views are small and held by value so temporaries
+ * in a chain like img | erode(se) | dilate(se) stay alive.
+ */
 template <class ImageT, class ViewT>
-class ViewBase
+class ViewBase : public ViewTag
 {
   using self_t    = ViewBase<ImageT, ViewT>;
   using derived_t = ViewT;
@@ -41,10 +85,222 @@ public:
   constexpr auto rows() const { return _img.rows(); }
   constexpr auto columns() const { return _img.columns(); }
 
+  /**
+   * Forget rows cached by nested views, e.g. after the input image changed
+   */
+  void invalidate() const { detail::invalidate(_img, 0); }
+
 protected:
-  const ImageT & _img;
+  std::conditional_t<is_view<ImageT>::value, const ImageT, const ImageT &>
+    _img;
 };
 
+namespace detail {
+
+template <class ImageT, class T>
+auto evaluate(const ImageT & img,
+              T *            dst,
+              std::size_t    stride,
+              std::size_t    i0,
+              std::size_t    i1,
+              std::size_t    j0,
+              std::size_t    j1,
+              int)
+  -> decltype(img.materialize_tile(dst, stride, i0, i1, j0, j1)) {
+  return img.materialize_tile(dst, stride, i0, i1, j0, j1);
+}
+
+template <class ImageT, class T>
+void evaluate(const ImageT & img,
+              T *            dst,
+              std::size_t    stride,
+              std::size_t    i0,
+              std::size_t    i1,
+              std::size_t    j0,
+              std::size_t    j1,
+              long) {
+  for (std::size_t i = i0; i < i1; ++i) {
+    T * row = dst + (i - i0) * stride;
+    for (std::size_t j = j0; j < j1; ++j) { row[j - j0] = img(i, j); }
+  }
+}
+
+}  // namespace detail
+
+/**
+ * \brief  Evaluate rows [i0, i1) and columns [j0, j1) of an image or view
+ *
+ * Pixel (i, j) is written to dst[(i - i0) * stride + (j - j0)]. Views may
+ * provide a member materialize_tile with the same signature to evaluate a
+ * whole tile at once, all others are evaluated element by element.
+ */
+template <class ImageT, class T>
+void evaluate(const ImageT & img,
+              T *            dst,
+              std::size_t    stride,
+              std::size_t    i0,
+              std::size_t    i1,
+              std::size_t    j0,
+              std::size_t    j1) {
+  detail::evaluate(img, dst, stride, i0, i1, j0, j1, 0);
+}
+
+/**
+ * View keeping the last evaluated rows of another view.
+ *
+ * Rows of the input are evaluated as a whole on first access and kept in a
+ * ring of n rows, so a neighborhood view of height up to n reading it in
+ * raster order evaluates every input pixel once instead of once per tap.
+ *
+ * The ring belongs to the view and to the first thread reading it, other
+ * threads read uncached and tiles are passed through uncached. Copies start
+ * with an empty ring. Rows are not re-evaluated when the input image
+ * changes, call invalidate() on the view or any view on top of it first.
+ */
+template <class ImageT>
+class CachedView : public ViewBase<ImageT, CachedView<ImageT>>
+{
+  using self_t = CachedView<ImageT>;
+  using base_t = ViewBase<ImageT, self_t>;
+
+public:
+  using ElementType = typename ImageT::ElementType;
+
+public:
+  CachedView(const ImageT & img, std::size_t rows)
+   : base_t(img), _n{std::max<std::size_t>(rows, 1)} {}
+
+  CachedView(const CachedView & other) : base_t(other), _n{other._n} {}
+
+public:
+  ElementType view_element(std::size_t i, std::size_t j) const {
+    if (!owned()) {
+      ElementType value;
+      evaluate(this->_img, &value, 1, i, i + 1, j, j + 1);
+      return value;
+    }
+
+    const std::size_t columns = this->_img.columns();
+    if (_ring.data.size() != _n * columns) {
+      _ring.data.resize(_n * columns);
+      _ring.tags.assign(_n, std::numeric_limits<std::size_t>::max());
+    }
+
+    ElementType * row = &_ring.data[(i % _n) * columns];
+    if (_ring.tags[i % _n] != i) {
+      evaluate(this->_img, row, columns, i, i + 1, 0, columns);
+      _ring.tags[i % _n] = i;
+    }
+    return row[j];
+  }
+
+  /**
+   * Forget the cached rows and those of nested views, the next thread
+   * reading the view takes over the ring. Not thread safe.
+   */
+  void invalidate() const {
+    std::fill(_ring.tags.begin(),
+              _ring.tags.end(),
+              std::numeric_limits<std::size_t>::max());
+    _owner.store(std::thread::id());
+    base_t::invalidate();
+  }
+
+  template <class T>
+  void materialize_tile(T *         dst,
+                        std::size_t stride,
+                        std::size_t i0,
+                        std::size_t i1,
+                        std::size_t j0,
+                        std::size_t j1) const {
+    evaluate(this->_img, dst, stride, i0, i1, j0, j1);
+  }
+
+private:
+  struct Ring
+  {
+    std::vector<ElementType> data;
+    std::vector<std::size_t> tags;
+  };
+
+  // Claim the ring for the calling thread if no other thread has
+  bool owned() const {
+    const auto self  = std::this_thread::get_id();
+    auto       owner = _owner.load(std::memory_order_acquire);
+    if (owner == self) { return true; }
+    if (owner != std::thread::id()) { return false; }
+    return _owner.compare_exchange_strong(owner, self);
+  }
+
+private:
+  std::size_t                          _n;
+  mutable std::atomic<std::thread::id> _owner{std::thread::id()};
+  mutable Ring                         _ring;
+};
+
+/**
+ * \brief  Cache the last evaluated rows of an image or view
+ */
+template <class ImageT>
+CachedView<ImageT> cache(const ImageT & img, std::size_t rows) {
+  return CachedView<ImageT>(img, rows);
+}
+
+/**
+ * Executor running everything on the calling thread
+ */
+struct Sequential
+{
+  template <class FnT>
+  void parallel_for(std::size_t n, FnT && fn, std::size_t = 1) {
+    if (n > 0) { fn(std::size_t{0}, n); }
+  }
+};
+
+/**
+ * \brief  Evaluate a view into a preallocated matrix, tile by tile
+ *
+ * The tiles are distributed with executor.parallel_for, e.g. on a
+ * parallel::ThreadPool. Neighborhood views evaluate the part of their
+ * input a tile depends on, including a halo of the size of the structuring
+ * element, into a small buffer first so every pixel of a nested view is
+ * computed once per tile instead of once per tap.
+ *
+ * \param[in]   view          Image or view
+ * \param[out]  out           Row-major matrix with the dimensions of view
+ * \param[in]   executor      Object providing parallel_for(n, fn, grain)
+ * \param[in]   tile_rows     Rows per tile
+ * \param[in]   tile_columns  Columns per tile
+ */
+template <class ViewT, class OutT, class ExecutorT>
+void materialize(const ViewT & view,
+                 OutT &        out,
+                 ExecutorT &   executor,
+                 std::size_t   tile_rows    = 64,
+                 std::size_t   tile_columns = 256) {
+  const std::size_t rows    = view.rows();
+  const std::size_t columns = view.columns();
+  const std::size_t tiles_h = (rows + tile_rows - 1) / tile_rows;
+  const std::size_t tiles_w = (columns + tile_columns - 1) / tile_columns;
+
+  executor.parallel_for(tiles_h * tiles_w, [&](std::size_t begin,
+                                               std::size_t end) {
+    for (std::size_t t = begin; t < end; ++t) {
+      const std::size_t i0 = (t / tiles_w) * tile_rows;
+      const std::size_t j0 = (t % tiles_w) * tile_columns;
+      const std::size_t i1 = std::min(rows, i0 + tile_rows);
+      const std::size_t j1 = std::min(columns, j0 + tile_columns);
+      evaluate(view, &out(i0, j0), out.spacing(), i0, i1, j0, j1);
+    }
+  });
+}
+
+template <class ViewT, class OutT>
+void materialize(const ViewT & view, OutT & out) {
+  auto executor = Sequential();
+  materialize(view, out, executor);
+}
+
 }  // namespace view
 }  // namespace balken
 
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__PARALLEL_H__INCLUDED
+#define BALKEN__PARALLEL_H__INCLUDED
+
+// cpp
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace balken {
+namespace parallel {
+
+/**
+ * Fixed size pool of worker threads.
+ *
+ * parallel_for splits an index range into chunks which are processed by the
+ * workers and the calling thread. A pool of size 0 runs everything on the
+ * calling thread.
+ */
+class ThreadPool
+{
+  struct Task
+  {
+    std::function<void(std::size_t, std::size_t)> fn;
+    std::size_t                                    n;
+    std::size_t                                    chunk;
+    std::size_t                                    chunks;
+    std::atomic<std::size_t>                       next{0};
+    std::atomic<std::size_t>                       done{0};
+  };
+
+public:
+  explicit ThreadPool(
+    std::size_t threads = std::max(1U, std::thread::hardware_concurrency()) -
+                          1) {
+    _workers.reserve(threads);
+    for (std::size_t t = 0; t < threads; ++t) {
+      _workers.emplace_back([this] { run(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_all();
+    for (auto & worker : _workers) { worker.join(); }
+  }
+
+  /**
+   * Number of threads working on a parallel_for, including the caller
+   */
+  std::size_t concurrency() const { return _workers.size() + 1; }
+
+  /**
+   * \brief  Call fn(begin, end) for chunks of [0, n) and wait for completion
+   *
+   * \param[in]  n      Size of the index range
+   * \param[in]  fn     Callable taking a half-open index range
+   * \param[in]  grain  Minimal number of indices per chunk
+   */
+  template <class FnT>
+  void parallel_for(std::size_t n, FnT && fn, std::size_t grain = 1) {
+    if (n == 0) { return; }
+
+    // A few chunks per thread to even out imbalanced work
+    const std::size_t chunk =
+      std::max(grain, (n + 4 * concurrency() - 1) / (4 * concurrency()));
+    if (_workers.empty() || chunk >= n) {
+      fn(std::size_t{0}, n);
+      return;
+    }
+
+    auto task    = std::make_shared<Task>();
+    task->fn     = std::forward<FnT>(fn);
+    task->n      = n;
+    task->chunk  = chunk;
+    task->chunks = (n + chunk - 1) / chunk;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _tasks.push_back(task);
+    }
+    _wake.notify_all();
+
+    work(*task);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [&task] { return task->done == task->chunks; });
+  }
+
+private:
+  void work(Task & task) {
+    for (;;) {
+      const auto c = task.next.fetch_add(1);
+      if (c >= task.chunks) { return; }
+
+      const auto begin = c * task.chunk;
+      task.fn(begin, std::min(task.n, begin + task.chunk));
+
+      if (task.done.fetch_add(1) + 1 == task.chunks) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finished.notify_all();
+      }
+    }
+  }
+
+  void run() {
+    for (;;) {
+      std::shared_ptr<Task> task;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait(lock, [this] { return _stop || !_tasks.empty(); });
+        if (_tasks.empty()) { return; }
+
+        task = _tasks.front();
+        if (task->next >= task->chunks) {
+          _tasks.pop_front();
+          continue;
+        }
+      }
+      work(*task);
+    }
+  }
+
+private:
+  std::vector<std::thread>          _workers;
+  std::deque<std::shared_ptr<Task>> _tasks;
+  std::mutex                        _mutex;
+  std::condition_variable           _wake;
+  std::condition_variable           _finished;
+  bool                              _stop{false};
+};
+
+}  // namespace parallel
+}  // namespace balken
+
+#endif
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__COMPACT_H__INCLUDED
+#define BALKEN__COMPACT_H__INCLUDED
+
+// cpp
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+
+// own
+#include "region/regions.h"
+#include "types.h"
+
+namespace balken {
+namespace regions {
+
+/**
+ * Read-only view of one region of a CompactRegions buffer
+ *
+ * Behaves like a const std::vector<Point> with points in raster scan order,
+ * elements are assembled from the coordinate arrays on access.
+ */
+class RegionView
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = Point;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const Point *;
+    using reference         = Point;
+
+  public:
+    iterator() = default;
+    iterator(const uint16_t * i, const uint16_t * j) : _i{i}, _j{j} {}
+
+    Point operator*() const { return Point(*_i, *_j); }
+    Point operator[](difference_type n) const {
+      return Point(_i[n], _j[n]);
+    }
+
+    iterator & operator++() {
+      ++_i;
+      ++_j;
+      return *this;
+    }
+    iterator operator++(int) {
+      auto ret = *this;
+      ++*this;
+      return ret;
+    }
+    iterator & operator--() {
+      --_i;
+      --_j;
+      return *this;
+    }
+    iterator operator--(int) {
+      auto ret = *this;
+      --*this;
+      return ret;
+    }
+    iterator & operator+=(difference_type n) {
+      _i += n;
+      _j += n;
+      return *this;
+    }
+    iterator & operator-=(difference_type n) { return *this += -n; }
+    iterator   operator+(difference_type n) const {
+      return iterator(*this) += n;
+    }
+    iterator operator-(difference_type n) const {
+      return iterator(*this) -= n;
+    }
+    difference_type operator-(const iterator & other) const {
+      return _i - other._i;
+    }
+
+    bool operator==(const iterator & other) const { return _i == other._i; }
+    bool operator!=(const iterator & other) const { return _i != other._i; }
+    bool operator<(const iterator & other) const { return _i < other._i; }
+    bool operator>(const iterator & other) const { return _i > other._i; }
+    bool operator<=(const iterator & other) const { return _i <= other._i; }
+    bool operator>=(const iterator & other) const { return _i >= other._i; }
+
+  private:
+    const uint16_t * _i{nullptr};
+    const uint16_t * _j{nullptr};
+  };
+
+  using value_type     = Point;
+  using const_iterator = iterator;
+
+public:
+  RegionView(const uint16_t * i, const uint16_t * j, std::size_t size)
+   : _i{i}, _j{j}, _size{size} {}
+
+  // Element Access
+  Point operator[](std::size_t k) const { return Point(_i[k], _j[k]); }
+  Point front() const { return (*this)[0]; }
+  Point back() const { return (*this)[_size - 1]; }
+
+  iterator begin() const { return iterator(_i, _j); }
+  iterator end() const { return iterator(_i + _size, _j + _size); }
+
+  std::size_t size() const { return _size; }
+  bool        empty() const { return _size == 0; }
+
+private:
+  const uint16_t * _i;
+  const uint16_t * _j;
+  std::size_t      _size;
+};
+
+/**
+ * Points of all regions of a frame in one structure-of-arrays buffer
+ *
+ * Coordinates are stored as 16 bit row and column arrays, region n spans
+ * [offset(n), offset(n + 1)) of both. Three allocations hold any number of
+ * regions, at half the size of std::vector<Point> storage.
+ */
+class CompactRegions
+{
+public:
+  CompactRegions() = default;
+
+  // Region Access
+  RegionView operator[](std::size_t n) const {
+    return RegionView(_i.data() + _offsets[n],
+                      _j.data() + _offsets[n],
+                      _offsets[n + 1] - _offsets[n]);
+  }
+  std::size_t offset(std::size_t n) const { return _offsets[n]; }
+  std::size_t size() const { return _offsets.size() - 1; }
+
+  // Total number of points of all regions
+  std::size_t points() const { return _i.size(); }
+
+private:
+  friend CompactRegions compact(const Labeling &             labeling,
+                                const std::vector<size_t> & selected);
+
+  std::vector<uint16_t>    _i;
+  std::vector<uint16_t>    _j;
+  std::vector<std::size_t> _offsets{0};
+};
+
+/**
+ * \brief  Gather the selected regions of a labeling into a compact buffer
+ *
+ * Offsets follow from the region areas, so a single raster scan places
+ * every point directly at its final position.
+ */
+inline CompactRegions compact(const Labeling &             labeling,
+                              const std::vector<size_t> & selected) {
+  assert(labeling.labels.rows() <= std::numeric_limits<uint16_t>::max() + 1UL);
+  assert(labeling.labels.columns() <=
+         std::numeric_limits<uint16_t>::max() + 1UL);
+
+  auto ret = CompactRegions();
+  // Slot of every label in the result, 0 for unselected ones
+  auto slot = std::vector<uint32_t>(labeling.size() + 1, 0);
+  ret._offsets.resize(selected.size() + 1);
+  for (size_t n = 0; n < selected.size(); ++n) {
+    slot[selected[n] + 1] = static_cast<uint32_t>(n + 1);
+    ret._offsets[n + 1] = ret._offsets[n] + labeling.stats.area[selected[n]];
+  }
+  ret._i.resize(ret._offsets.back());
+  ret._j.resize(ret._offsets.back());
+
+  // Write position of every region
+  auto next =
+    std::vector<size_t>(ret._offsets.begin(), ret._offsets.end() - 1);
+  for (size_t i = 0; i < labeling.labels.rows(); ++i) {
+    for (size_t j = 0; j < labeling.labels.columns(); ++j) {
+      if (const auto n = slot[labeling.labels(i, j)]) {
+        const auto k = next[n - 1]++;
+        ret._i[k]    = static_cast<uint16_t>(i);
+        ret._j[k]    = static_cast<uint16_t>(j);
+      }
+    }
+  }
+  return ret;
+}
+
+/**
+ * \brief  Gather all regions of a labeling into a compact buffer
+ */
+inline CompactRegions compact(const Labeling & labeling) {
+  auto all = std::vector<size_t>(labeling.size());
+  std::iota(all.begin(), all.end(), size_t{0});
+  return compact(labeling, all);
+}
+
+/**
+ * Convex hull of a compact region, its points are already in raster order
+ */
+inline std::vector<Point> convex_hull(RegionView region) {
+  return detail::monotone_chain(region);
+}
+
+/**
+ * Convert compact regions to image
+ */
+template <class ImageT>
+blaze::DynamicMatrix<uint8_t> from_regions(const ImageT &         img,
+                                           const CompactRegions & regions) {
+  auto reg = blaze::DynamicMatrix<uint8_t>(img.rows(), img.columns(), 0);
+  for (size_t n = 0; n < regions.size(); ++n) {
+    for (const auto & point : regions[n]) {
+      reg(point.i, point.j) = static_cast<uint8_t>(n + 1);
+    }
+  }
+  return reg;
+}
+
+}  // namespace regions
+}  // namespace balken
+
+#endif
@@ -13,11 +13,14 @@
 #include <blaze/math/DynamicMatrix.h>
 
 // cpp
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <limits>
-#include <stack>
+#include <utility>
 #include <vector>
+#include "arena.h"
+#include "image/rle.h"
 #include "types.h"
 
 namespace balken {
@@ -29,88 +32,145 @@ int cross(const Point & O, const Point & A, const Point & B) {
   return (A.j - O.j) * (B.i - O.i) - (A.i - O.i) * (B.j - O.j);
 }
 
-template <class BinaryImageT>
-std::vector<Point> walk_region(const BinaryImageT &         img,
-                               Point                        point,
-                               blaze::DynamicMatrix<bool> & visited) {
-  auto stack  = std::stack<Point>();
-  auto region = std::vector<Point>();
-
-  stack.push(point);
-  while (!stack.empty()) {
-    // Pop stack head
-    auto cur = stack.top();
-    stack.pop();
-
-    if (visited(cur.i, cur.j)) { continue; }
-
-    // Mark point visioed
-    visited(cur.i, cur.j) = true;
-    region.push_back(cur);
+/**
+ * B lies left of the line O -> A, or on the segment between them
+ */
+inline bool covers(const Point & O, const Point & A, const Point & B) {
+  const int c = cross(O, A, B);
+  if (c != 0) { return c > 0; }
+  return B.i >= std::min(O.i, A.i) && B.i <= std::max(O.i, A.i) &&
+         B.j >= std::min(O.j, A.j) && B.j <= std::max(O.j, A.j);
+}
 
-    if (!(cur.i < 0) && img(cur.i - 1, cur.j)) {
-      stack.emplace(cur.i - 1, cur.j);
-    }
-    if (!(cur.j < 0) && img(cur.i, cur.j - 1)) {
-      stack.emplace(cur.i, cur.j - 1);
-    }
-    if (!(cur.i == static_cast<int>(img.rows())) && img(cur.i + 1, cur.j)) {
-      stack.emplace(cur.i + 1, cur.j);
-    }
-    if (!(cur.j == static_cast<int>(img.columns())) && img(cur.i, cur.j + 1)) {
-      stack.emplace(cur.i, cur.j + 1);
-    }
+/**
+ * Root of a label in the union-find forest, with path halving
+ */
+template <class ParentT>
+uint32_t find_root(ParentT & parent, uint32_t label) {
+  while (parent[label] != label) {
+    parent[label] = parent[parent[label]];
+    label         = parent[label];
   }
+  return label;
+}
 
-  return region;
+/**
+ * Merge two labels, the smaller label becomes the root
+ */
+template <class ParentT>
+uint32_t merge(ParentT & parent, uint32_t a, uint32_t b) {
+  a = find_root(parent, a);
+  b = find_root(parent, b);
+  if (a < b) {
+    parent[b] = a;
+    return a;
+  }
+  parent[a] = b;
+  return b;
 }
+
 }  // namespace detail
 
+/**
+ * Minimal-area enclosing rectangle of a convex hull (rotating calipers)
+ *
+ * One side of the optimal rectangle is collinear with a hull edge, so every
+ * edge is tried in turn. The three other calipers (farthest point and both
+ * extremes along the edge) only ever advance, which makes the whole sweep
+ * O(h). Projections are done in exact integer arithmetic.
+ *
+ * U is the unit direction (i, j) of the side lying on the hull edge, the
+ * corners are rounded to the nearest pixel in traversal order.
+ */
 template <class HullT>
-std::vector<Point> minimal_bounding_rectangle(const HullT & hull) {
-  auto p1 = hull[0];
-  auto p2 = hull[1];
-
-  if (p1.j > p2.j) { std::swap(p1, p2); }
-  double angle =
-    std::atan2(static_cast<double>(p1.i) - static_cast<double>(p2.i),
-               static_cast<double>(p1.j) - static_cast<double>(p2.j));
-
-  p1 = hull[1];
-  p2 = hull[2];
-
-  if (p1.j > p2.j) { std::swap(p1, p2); }
-  angle = std::atan2(static_cast<double>(p1.i) - static_cast<double>(p2.i),
-                     static_cast<double>(p1.j) - static_cast<double>(p2.j));
-
-  p1 = hull[2];
-  p2 = hull[3];
-
-  if (p1.j > p2.j) { std::swap(p1, p2); }
-  angle = std::atan2(static_cast<double>(p1.i) - static_cast<double>(p2.i),
-                     static_cast<double>(p1.j) - static_cast<double>(p2.j));
+Rectangle minimal_bounding_rectangle(const HullT & hull) {
+  auto ret = Rectangle{{1.F, 0.F}, {}, 0};
+  const size_t h = hull.size();
+  if (h == 0) { return ret; }
+  if (h < 3) {
+    ret.points = {hull[0], hull[h - 1], hull[h - 1], hull[0]};
+    return ret;
+  }
 
-  p1 = hull[3];
-  p2 = hull[0];
+  const auto dot = [&](size_t k, size_t p) {
+    const auto & a = hull[k];
+    const auto & b = hull[(k + 1) % h];
+    return static_cast<int64_t>(b.i - a.i) * (hull[p % h].i - a.i) +
+           static_cast<int64_t>(b.j - a.j) * (hull[p % h].j - a.j);
+  };
+  const auto dist = [&](size_t k, size_t p) {
+    const auto & a = hull[k];
+    const auto & b = hull[(k + 1) % h];
+    return std::abs(static_cast<int64_t>(b.i - a.i) * (hull[p % h].j - a.j) -
+                    static_cast<int64_t>(b.j - a.j) * (hull[p % h].i - a.i));
+  };
+
+  double best  = std::numeric_limits<double>::max();
+  size_t far   = 1;
+  size_t right = 1;
+  size_t left  = 0;
+  for (size_t k = 0; k < h; ++k) {
+    const auto & a  = hull[k];
+    const auto & b  = hull[(k + 1) % h];
+    const auto   di = static_cast<int64_t>(b.i - a.i);
+    const auto   dj = static_cast<int64_t>(b.j - a.j);
+    const auto   l2 = di * di + dj * dj;
+    if (l2 == 0) { continue; }
+
+    // Every caliper wraps around at most once per sweep
+    for (size_t n = 0; n < h && dist(k, far + 1) >= dist(k, far); ++n) {
+      ++far;
+    }
+    for (size_t n = 0; n < h && dot(k, right + 1) >= dot(k, right); ++n) {
+      ++right;
+    }
+    if (k == 0) { left = far; }
+    for (size_t n = 0; n < h && dot(k, left + 1) <= dot(k, left); ++n) {
+      ++left;
+    }
 
-  if (p1.j > p2.j) { std::swap(p1, p2); }
-  angle = std::atan2(static_cast<double>(p1.i) - static_cast<double>(p2.i),
-                     static_cast<double>(p1.j) - static_cast<double>(p2.j));
-  return hull;
+    const double height = static_cast<double>(dist(k, far));
+    const double width  = static_cast<double>(dot(k, right) - dot(k, left));
+    const double area   = width * height / static_cast<double>(l2);
+    if (area >= best) { continue; }
+    best = area;
+
+    // Edge direction and unit normal pointing into the hull
+    const double len   = std::sqrt(static_cast<double>(l2));
+    const double ui    = di / len;
+    const double uj    = dj / len;
+    const auto & f     = hull[far % h];
+    const double side  = dj * (f.i - a.i) - di * (f.j - a.j) < 0 ? -1. : 1.;
+    const double ni    = side * uj;
+    const double nj    = -side * ui;
+    const double t0    = dot(k, left) / len;
+    const double t1    = dot(k, right) / len;
+    const double depth = height / len;
+
+    const auto corner = [&](double t, double d) {
+      return Point(static_cast<int>(std::lround(a.i + t * ui + d * ni)),
+                   static_cast<int>(std::lround(a.j + t * uj + d * nj)));
+    };
+    ret.U      = {static_cast<float>(ui), static_cast<float>(uj)};
+    ret.points = {
+      corner(t0, 0.), corner(t1, 0.), corner(t1, depth), corner(t0, depth)};
+    ret.area = static_cast<size_t>(std::lround(area));
+  }
+  return ret;
 }
 
 /**
  * Minimal axis-aligned bounding box
  */
 template <class RegionT>
-std::vector<Point> bounding_box(RegionT & region) {
+std::vector<Point> bounding_box(const RegionT & region) {
   auto max_i = region[0].i;
   auto min_i = region[0].i;
 
   auto max_j = region[0].j;
   auto min_j = region[0].j;
 
-  for (auto & point : region) {
+  for (const auto & point : region) {
     max_i = std::max(max_i, point.i);
     min_i = std::min(min_i, point.i);
     max_j = std::max(max_j, point.j);
@@ -123,19 +183,19 @@ std::vector<Point> bounding_box(RegionT & region) {
                             Point(max_i, min_j)};
 }
 
+namespace detail {
+
 /**
- * Calculate the regions convex hull
+ * Andrew's monotone chain over points sorted in raster order
  */
-template <class RegionT>
-std::vector<Point> convex_hull(RegionT & region) {
+template <class SortedT>
+std::vector<Point> monotone_chain(const SortedT & region) {
   size_t n = region.size();
   size_t k = 0;
 
-  if (n <= 3) { return region; }
+  if (n <= 3) { return std::vector<Point>(region.begin(), region.end()); }
   auto hull = std::vector<Point>(2 * n);
 
-  std::sort(region.begin(), region.end());
-
   // Build lower hull
   for (size_t i = 0; i < n; ++i) {
     while (k >= 2 && detail::cross(hull[k - 2], hull[k - 1], region[i]) <= 0)
@@ -155,27 +215,519 @@ std::vector<Point> convex_hull(RegionT & region) {
   return hull;
 }
 
+}  // namespace detail
+
+/**
+ * Calculate the regions convex hull
+ */
+template <class RegionT>
+std::vector<Point> convex_hull(RegionT & region) {
+  std::sort(region.begin(), region.end());
+  return detail::monotone_chain(region);
+}
+
 /**
- * One Component at a time algorithm
+ * Convex hull of a simple polyline (Melkman)
+ *
+ * Points are consumed in order and kept in a deque that always forms the
+ * hull of the prefix seen so far, so the cost is linear in the number of
+ * points and no sorting is needed. The polyline has to be simple, Melkman
+ * may miss vertices of self-touching borders.
+ */
+template <class PolylineT>
+std::vector<Point> melkman(const PolylineT & line) {
+  const size_t n = line.size();
+  if (n < 3) { return std::vector<Point>(line.begin(), line.end()); }
+
+  // Find a non-degenerate starting triangle. The second point is the
+  // farthest of the leading collinear run, which lies on one side of the
+  // first point if that one is topmost.
+  const Point & v0 = line[0];
+  size_t        k  = 1;
+  size_t        v1 = 0;
+  auto          d1 = int64_t{0};
+  for (; k < n && detail::cross(v0, line[v1], line[k]) == 0; ++k) {
+    const auto di = static_cast<int64_t>(line[k].i - v0.i);
+    const auto dj = static_cast<int64_t>(line[k].j - v0.j);
+    const auto d  = di * di + dj * dj;
+    if (d > d1) {
+      d1 = d;
+      v1 = k;
+    }
+  }
+  if (k == n) {
+    return d1 ? std::vector<Point>{v0, line[v1]} : std::vector<Point>{v0};
+  }
+
+  auto   deque  = std::vector<Point>(2 * n + 1);
+  size_t bottom = n;
+  size_t top    = n + 3;
+  if (detail::cross(v0, line[v1], line[k]) > 0) {
+    deque[n + 1] = v0;
+    deque[n + 2] = line[v1];
+  } else {
+    deque[n + 1] = line[v1];
+    deque[n + 2] = v0;
+  }
+  deque[bottom] = deque[top] = line[k];
+
+  for (++k; k < n; ++k) {
+    const Point & v = line[k];
+    // Inside the current hull or on its border
+    if (detail::covers(deque[bottom], deque[bottom + 1], v) &&
+        detail::covers(deque[top - 1], deque[top], v)) {
+      continue;
+    }
+    while (top - bottom > 1 &&
+           detail::cross(deque[top - 1], deque[top], v) <= 0) {
+      --top;
+    }
+    deque[++top] = v;
+    while (top - bottom > 1 &&
+           detail::cross(v, deque[bottom], deque[bottom + 1]) <= 0) {
+      ++bottom;
+    }
+    deque[--bottom] = v;
+  }
+
+  return std::vector<Point>(deque.begin() + bottom, deque.begin() + top);
+}
+
+/**
+ * Outer border of the region containing start (Moore neighbour tracing)
+ *
+ * start has to be the first pixel of its region in raster scan order.
+ * Border pixels are returned clockwise, pixels on one pixel wide parts are
+ * visited once per side. Pixels outside of the image count as background.
+ */
+template <class LabelsT>
+std::vector<Point> contour(const LabelsT & labels, Point start) {
+  static constexpr int di[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  static constexpr int dj[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+  // Direction of the offset (i + 1, j + 1), the centre is unused
+  static constexpr int dir[9] = {5, 6, 7, 4, 0, 0, 3, 2, 1};
+
+  const auto rows    = static_cast<int>(labels.rows());
+  const auto columns = static_cast<int>(labels.columns());
+  const auto label   = labels(start.i, start.j);
+  const auto inside  = [&](int i, int j) {
+    return i >= 0 && j >= 0 && i < rows && j < columns && labels(i, j) == label;
+  };
+
+  auto ret = std::vector<Point>{start};
+  auto p   = start;
+  // Backtrack neighbour, the pixel left of the start is background
+  int  back  = 4;
+  auto first = Point();
+  for (;;) {
+    int d = 1;
+    while (d < 8 &&
+           !inside(p.i + di[(back + d) % 8], p.j + dj[(back + d) % 8])) {
+      ++d;
+    }
+    // Isolated pixel
+    if (d == 8) { return ret; }
+
+    const int  next = (back + d) % 8;
+    const int  prev = (back + d - 1) % 8;
+    const auto c    = Point(p.i + di[next], p.j + dj[next]);
+    if (p.i == start.i && p.j == start.j) {
+      if (ret.size() > 1 && c.i == first.i && c.j == first.j) { break; }
+      if (ret.size() == 1) { first = c; }
+    }
+
+    back = dir[(di[prev] - di[next] + 1) * 3 + dj[prev] - dj[next] + 1];
+    p    = c;
+    ret.push_back(c);
+  }
+  // The start pixel was appended again when the border closed
+  ret.pop_back();
+  return ret;
+}
+
+/**
+ * Shape descriptors of a single region, derived from its moments
+ */
+struct Shape
+{
+  uint64_t area;
+  Point    min;
+  Point    max;
+  double   mean_i;
+  double   mean_j;
+  // Second order central moments, normalized by the area
+  double   mu_ii;
+  double   mu_jj;
+  double   mu_ij;
+
+  std::pair<double, double> centroid() const {
+    return std::make_pair(mean_i, mean_j);
+  }
+
+  /**
+   * \brief  Angle of the major axis against the j axis in (-pi/2, pi/2]
+   */
+  double orientation() const {
+    return 0.5 * std::atan2(2. * mu_ij, mu_jj - mu_ii);
+  }
+
+  /**
+   * \brief  Eccentricity of the ellipse with the same second moments, 0 for
+   *         circles and 1 for lines
+   */
+  double eccentricity() const {
+    const double spread = std::sqrt(4. * mu_ij * mu_ij +
+                                    (mu_ii - mu_jj) * (mu_ii - mu_jj));
+    const double major  = mu_ii + mu_jj + spread;
+    const double minor  = mu_ii + mu_jj - spread;
+    return major > 0. ? std::sqrt(std::max(0., 1. - minor / major)) : 0.;
+  }
+
+  /**
+   * \brief  Fraction of the axis-aligned bounding box covered by the region
+   */
+  double fill_ratio() const {
+    return static_cast<double>(area) /
+           (static_cast<double>(max.i - min.i + 1) * (max.j - min.j + 1));
+  }
+};
+
+/**
+ * Per region statistics collected while labeling
+ *
+ * Raw moments up to second order and bounding boxes of all regions, stored
+ * as one array per quantity so predicates over a single quantity stream
+ * through contiguous memory. Pixels are added a run at a time.
+ */
+struct Statistics
+{
+  std::vector<uint64_t> area;
+  std::vector<int>      min_i;
+  std::vector<int>      min_j;
+  std::vector<int>      max_i;
+  std::vector<int>      max_j;
+  std::vector<uint64_t> sum_i;
+  std::vector<uint64_t> sum_j;
+  std::vector<uint64_t> sum_ii;
+  std::vector<uint64_t> sum_jj;
+  std::vector<uint64_t> sum_ij;
+
+  size_t size() const { return area.size(); }
+
+  void resize(size_t n) {
+    area.assign(n, 0);
+    min_i.assign(n, std::numeric_limits<int>::max());
+    min_j.assign(n, std::numeric_limits<int>::max());
+    max_i.assign(n, 0);
+    max_j.assign(n, 0);
+    sum_i.assign(n, 0);
+    sum_j.assign(n, 0);
+    sum_ii.assign(n, 0);
+    sum_jj.assign(n, 0);
+    sum_ij.assign(n, 0);
+  }
+
+  // Add pixels (i, begin) ... (i, end - 1) of a run to region n
+  void add(size_t n, int i, int begin, int end) {
+    const auto count = static_cast<uint64_t>(end - begin);
+    const auto row   = static_cast<uint64_t>(i);
+    // Sums of j and j^2 over [begin, end)
+    const auto b  = static_cast<uint64_t>(begin);
+    const auto e  = static_cast<uint64_t>(end);
+    const auto sj = count * (b + e - 1) / 2;
+    const auto sjj =
+      (e * (e - 1) * (2 * e - 1) - b * (b - 1) * (2 * b - 1)) / 6;
+
+    area[n] += count;
+    min_i[n] = std::min(min_i[n], i);
+    min_j[n] = std::min(min_j[n], begin);
+    max_i[n] = std::max(max_i[n], i);
+    max_j[n] = std::max(max_j[n], end - 1);
+    sum_i[n] += count * row;
+    sum_j[n] += sj;
+    sum_ii[n] += count * row * row;
+    sum_jj[n] += sjj;
+    sum_ij[n] += row * sj;
+  }
+
+  Shape operator[](size_t n) const {
+    const double a  = static_cast<double>(area[n]);
+    const double mi = sum_i[n] / a;
+    const double mj = sum_j[n] / a;
+    return Shape{area[n],
+                 Point(min_i[n], min_j[n]),
+                 Point(max_i[n], max_j[n]),
+                 mi,
+                 mj,
+                 sum_ii[n] / a - mi * mi,
+                 sum_jj[n] / a - mj * mj,
+                 sum_ij[n] / a - mi * mj};
+  }
+};
+
+/**
+ * Label image and per label statistics.
+ *
+ * Label 0 is background, region n has label n + 1 and its statistics are
+ * stored in stats[n].
+ */
+struct Labeling
+{
+  blaze::DynamicMatrix<uint32_t> labels;
+  Statistics                     stats;
+
+  size_t size() const { return stats.size(); }
+};
+
+/**
+ * Two-pass union-find connected component labeling (4-connectivity)
+ *
+ * The first pass assigns provisional labels and records equivalences, the
+ * second pass resolves them and collects region statistics. Regions are
+ * numbered in order of their first pixel in raster scan order.
+ *
+ * The result is written to ret, whose buffers are reused when labeling
+ * frames of the same size, the equivalence table is taken from arena.
  */
 template <class BinaryImageT>
-std::vector<std::vector<Point>> find(const BinaryImageT & img) {
-  auto visited = blaze::DynamicMatrix<bool>(img.rows(), img.columns(), false);
-  auto stack   = std::stack<Point>();
-  auto regions = std::vector<std::vector<Point>>();
-  regions.reserve(img.rows() * img.columns());
-
-  for (int i = 0; i < static_cast<int>(img.rows()); ++i) {
-    for (int j = 0; j < static_cast<int>(img.columns()); ++j) {
-      if (img(i, j) == std::numeric_limits<uint8_t>::max() &&
-          visited(i, j) == false) {
-        regions.push_back(detail::walk_region(img, Point(i, j), visited));
+void label(const BinaryImageT & img,
+           Labeling &           ret,
+           arena::FrameArena &  arena) {
+  const auto rows    = static_cast<int>(img.rows());
+  const auto columns = static_cast<int>(img.columns());
+
+  auto & labels = ret.labels;
+  labels.resize(img.rows(), img.columns(), false);
+  labels = 0U;
+
+  // First pass, provisional labels
+  auto parent =
+    arena::Vector<uint32_t>(1, 0U, arena::Allocator<uint32_t>(arena));
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < columns; ++j) {
+      if (img(i, j) != std::numeric_limits<uint8_t>::max()) { continue; }
+
+      const uint32_t up   = i > 0 ? labels(i - 1, j) : 0;
+      const uint32_t left = j > 0 ? labels(i, j - 1) : 0;
+
+      if (up && left) {
+        labels(i, j) = up == left ? up : detail::merge(parent, up, left);
+      } else if (up || left) {
+        labels(i, j) = up | left;
+      } else {
+        labels(i, j) = static_cast<uint32_t>(parent.size());
+        parent.push_back(labels(i, j));
+      }
+    }
+  }
+
+  // Flatten equivalences into consecutive labels. Roots are always the
+  // smallest label of a tree, so a single ordered sweep suffices.
+  auto next = uint32_t{0};
+  for (size_t l = 1; l < parent.size(); ++l) {
+    parent[l] = parent[l] == l ? ++next : parent[parent[l]];
+  }
+
+  // Second pass, final labels and statistics. Horizontal runs always
+  // belong to a single region and are accumulated at once.
+  ret.stats.resize(next);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < columns;) {
+      if (labels(i, j) == 0) {
+        ++j;
+        continue;
+      }
+      const int begin = j;
+      for (; j < columns && labels(i, j) != 0; ++j) {
+        labels(i, j) = parent[labels(i, j)];
+      }
+      ret.stats.add(labels(i, begin) - 1, i, begin, j);
+    }
+  }
+}
+
+template <class BinaryImageT>
+Labeling label(const BinaryImageT & img) {
+  auto              ret = Labeling();
+  arena::FrameArena scratch;
+  label(img, ret, scratch);
+  return ret;
+}
+
+/**
+ * Labels of a run-length encoded image, one per run
+ */
+struct RunLabeling
+{
+  std::vector<uint32_t> labels;
+  Statistics            stats;
+
+  size_t size() const { return stats.size(); }
+};
+
+/**
+ * Connected component labeling on runs (4-connectivity)
+ *
+ * Runs of consecutive rows are merged if their column ranges overlap, so
+ * the cost depends on the number of runs instead of the number of pixels.
+ */
+inline RunLabeling label(const rle::RunLengthImage & img) {
+  auto ret = RunLabeling();
+  if (img.rows() == 0) { return ret; }
+
+  auto & labels = ret.labels;
+  labels.resize(img.size());
+
+  // Runs of all rows are stored contiguously
+  const auto base   = img.begin(0);
+  auto       parent = std::vector<uint32_t>{0};
+  for (size_t i = 0; i < img.rows(); ++i) {
+    // Sweep both rows, runs overlap if neither ends before the other begins
+    auto above = i > 0 ? img.begin(i - 1) : img.begin(i);
+    auto stop  = i > 0 ? img.end(i - 1) : img.begin(i);
+    for (auto run = img.begin(i); run != img.end(i); ++run) {
+      auto & l = labels[run - base];
+      l        = 0;
+      while (above != stop && above->end <= run->begin) { ++above; }
+      for (auto a = above; a != stop && a->begin < run->end; ++a) {
+        l = l ? detail::merge(parent, l, labels[a - base]) : labels[a - base];
+      }
+      if (!l) {
+        l = static_cast<uint32_t>(parent.size());
+        parent.push_back(l);
+      }
+    }
+  }
+
+  // Flatten equivalences into consecutive labels
+  auto next = uint32_t{0};
+  for (size_t l = 1; l < parent.size(); ++l) {
+    parent[l] = parent[l] == l ? ++next : parent[parent[l]];
+  }
+
+  ret.stats.resize(next);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (auto run = img.begin(i); run != img.end(i); ++run) {
+      auto & l = labels[run - base];
+      l        = parent[l];
+      ret.stats.add(l - 1, static_cast<int>(i), run->begin, run->end);
+    }
+  }
+  return ret;
+}
+
+/**
+ * Convex hull of region n of a labeling
+ *
+ * Only the border of the region is traced, so the cost scales with the
+ * perimeter instead of the area. The leftmost and rightmost border pixel
+ * of every row form a row-monotone and therefore simple polygon with the
+ * same hull, which is what melkman gets to see.
+ */
+inline std::vector<Point> convex_hull(const Labeling & labeling, size_t n) {
+  const auto stats = labeling.stats[n];
+  const auto label = static_cast<uint32_t>(n + 1);
+
+  // First pixel in raster order lies in the topmost row
+  auto j = stats.min.j;
+  while (labeling.labels(stats.min.i, j) != label) { ++j; }
+
+  const auto rows  = static_cast<size_t>(stats.max.i - stats.min.i + 1);
+  auto       left  = std::vector<int>(rows, std::numeric_limits<int>::max());
+  auto       right = std::vector<int>(rows, std::numeric_limits<int>::min());
+  for (const auto & p : contour(labeling.labels, Point(stats.min.i, j))) {
+    left[p.i - stats.min.i]  = std::min(left[p.i - stats.min.i], p.j);
+    right[p.i - stats.min.i] = std::max(right[p.i - stats.min.i], p.j);
+  }
+
+  auto polygon = std::vector<Point>();
+  polygon.reserve(2 * rows);
+  for (size_t i = 0; i < rows; ++i) {
+    polygon.emplace_back(stats.min.i + static_cast<int>(i), right[i]);
+  }
+  for (size_t i = rows; i-- > 0;) {
+    if (left[i] != right[i]) {
+      polygon.emplace_back(stats.min.i + static_cast<int>(i), left[i]);
+    }
+  }
+  return melkman(polygon);
+}
+
+/**
+ * Build point lists of all regions of a labeling
+ */
+inline std::vector<std::vector<Point>> points(const Labeling & labeling) {
+  auto regions = std::vector<std::vector<Point>>(labeling.size());
+  for (size_t n = 0; n < labeling.size(); ++n) {
+    regions[n].reserve(labeling.stats.area[n]);
+  }
+
+  for (size_t i = 0; i < labeling.labels.rows(); ++i) {
+    for (size_t j = 0; j < labeling.labels.columns(); ++j) {
+      if (labeling.labels(i, j)) {
+        regions[labeling.labels(i, j) - 1].emplace_back(i, j);
+      }
+    }
+  }
+  return regions;
+}
+
+/**
+ * Build point lists of the selected regions of a labeling only
+ */
+inline std::vector<std::vector<Point>> points(
+  const Labeling & labeling, const std::vector<size_t> & selected) {
+  // Slot of every label in the result, 0 for unselected ones
+  auto slot    = std::vector<uint32_t>(labeling.size() + 1, 0);
+  auto regions = std::vector<std::vector<Point>>(selected.size());
+  for (size_t n = 0; n < selected.size(); ++n) {
+    slot[selected[n] + 1] = static_cast<uint32_t>(n + 1);
+    regions[n].reserve(labeling.stats.area[selected[n]]);
+  }
+
+  for (size_t i = 0; i < labeling.labels.rows(); ++i) {
+    for (size_t j = 0; j < labeling.labels.columns(); ++j) {
+      if (const auto n = slot[labeling.labels(i, j)]) {
+        regions[n - 1].emplace_back(i, j);
+      }
+    }
+  }
+  return regions;
+}
+
+/**
+ * Build point lists of all regions of a run labeling
+ */
+inline std::vector<std::vector<Point>> points(
+  const rle::RunLengthImage & img, const RunLabeling & labeling) {
+  auto regions = std::vector<std::vector<Point>>(labeling.size());
+  for (size_t n = 0; n < labeling.size(); ++n) {
+    regions[n].reserve(labeling.stats.area[n]);
+  }
+
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (auto run = img.begin(i); run != img.end(i); ++run) {
+      auto & region = regions[labeling.labels[run - img.begin(0)] - 1];
+      for (int j = run->begin; j < run->end; ++j) {
+        region.emplace_back(static_cast<int>(i), j);
       }
     }
   }
   return regions;
 }
 
+/**
+ * Find all connected regions of a binary image
+ */
+template <class BinaryImageT>
+std::vector<std::vector<Point>> find(const BinaryImageT & img) {
+  return points(label(img));
+}
+
+inline std::vector<std::vector<Point>> find(const rle::RunLengthImage & img) {
+  return points(img, label(img));
+}
+
 /**
  * Convert list of regions to image
  */
@@ -191,6 +743,10 @@ blaze::DynamicMatrix<uint8_t> from_regions(
   return reg;
 }
 
+inline std::pair<size_t, size_t> dimensions(const Shape & shape) {
+  return std::make_pair(shape.max.i - shape.min.i, shape.max.j - shape.min.j);
+}
+
 template <class RegionT>
 std::pair<size_t, size_t> dimensions(const RegionT & region) {
   auto max_i = size_t{0};
@@ -199,7 +755,7 @@ std::pair<size_t, size_t> dimensions(const RegionT & region) {
   auto max_j = size_t{0};
   auto min_j = size_t{std::numeric_limits<size_t>::max()};
 
-  for (auto & element : region) {
+  for (const auto & element : region) {
     min_i = std::min(min_i, static_cast<size_t>(element.i));
     max_i = std::max(max_i, static_cast<size_t>(element.i));
     min_j = std::min(min_j, static_cast<size_t>(element.j));
@@ -209,6 +765,177 @@ std::pair<size_t, size_t> dimensions(const RegionT & region) {
   return std::make_pair(max_i - min_i, max_j - min_j);
 }
 
+/**
+ * Number of pixel centres covered by a convex hull
+ *
+ * Pick's theorem counts the interior lattice points from twice the polygon
+ * area and the lattice points on its border.
+ */
+template <class HullT>
+uint64_t hull_pixels(const HullT & hull) {
+  int64_t area2  = 0;
+  int64_t border = 0;
+  for (size_t k = 0; k < hull.size(); ++k) {
+    const auto & a = hull[k];
+    const auto & b = hull[(k + 1) % hull.size()];
+    area2 += static_cast<int64_t>(a.i) * b.j - static_cast<int64_t>(b.i) * a.j;
+
+    auto x = std::abs(b.i - a.i);
+    auto y = std::abs(b.j - a.j);
+    while (y) { x = std::exchange(y, x % y); }
+    border += x;
+  }
+  return static_cast<uint64_t>((std::abs(area2) + border) / 2 + 1);
+}
+
+/**
+ * \brief  Fraction of the convex hull covered by region n
+ */
+inline double solidity(const Labeling & labeling, size_t n) {
+  return static_cast<double>(labeling.stats.area[n]) /
+         hull_pixels(convex_hull(labeling, n));
+}
+
+/**
+ * Composable region predicates with early rejection
+ *
+ * Every predicate narrows down a list of region indices in a separate pass.
+ * Passes run cheapest first regardless of the order they were added in:
+ * area, bounding box aspect ratio, fill ratio, orientation and finally hull
+ * solidity, which is the only one that touches the label image. Point
+ * lists are never built or moved.
+ *
+ *   auto candidates = regions::Selection()
+ *                       .area(size / 50, size / 10)
+ *                       .aspect(2.)
+ *                       .solidity(0.8)(labeling);
+ */
+class Selection
+{
+public:
+  /**
+   * \brief  Keep regions of min_area to max_area pixels
+   */
+  Selection & area(uint64_t min_area, uint64_t max_area) {
+    _min_area = min_area;
+    _max_area = max_area;
+    return *this;
+  }
+
+  /**
+   * \brief  Keep regions whose bounding box sides differ at most by a
+   *         factor of max_ratio
+   */
+  Selection & aspect(double max_ratio) {
+    _max_aspect = max_ratio;
+    return *this;
+  }
+
+  /**
+   * \brief  Keep regions covering min_ratio to max_ratio of their bounding
+   *         box
+   */
+  Selection & fill_ratio(double min_ratio, double max_ratio = 1.) {
+    _min_fill = min_ratio;
+    _max_fill = max_ratio;
+    return *this;
+  }
+
+  /**
+   * \brief  Keep regions whose major axis angle lies in [min_angle,
+   *         max_angle], see Shape::orientation
+   */
+  Selection & orientation(double min_angle, double max_angle) {
+    _orientation = true;
+    _min_angle   = min_angle;
+    _max_angle   = max_angle;
+    return *this;
+  }
+
+  /**
+   * \brief  Keep regions covering at least min_ratio of their convex hull
+   */
+  Selection & solidity(double min_ratio) {
+    _min_solidity = min_ratio;
+    return *this;
+  }
+
+  /**
+   * \brief  Indices of all regions passing the statistics based predicates
+   *
+   * Solidity needs the label image and is ignored here.
+   */
+  std::vector<size_t> operator()(const Statistics & stats) const {
+    auto ret = std::vector<size_t>();
+    for (size_t n = 0; n < stats.size(); ++n) {
+      if (stats.area[n] >= _min_area && stats.area[n] <= _max_area) {
+        ret.push_back(n);
+      }
+    }
+
+    if (_max_aspect < std::numeric_limits<double>::max()) {
+      keep(ret, [&](size_t n) {
+        const double h = stats.max_i[n] - stats.min_i[n] + 1;
+        const double w = stats.max_j[n] - stats.min_j[n] + 1;
+        return std::max(h, w) <= _max_aspect * std::min(h, w);
+      });
+    }
+    if (_min_fill > 0. || _max_fill < 1.) {
+      keep(ret, [&](size_t n) {
+        const double fill = stats[n].fill_ratio();
+        return fill >= _min_fill && fill <= _max_fill;
+      });
+    }
+    if (_orientation) {
+      keep(ret, [&](size_t n) {
+        const double angle = stats[n].orientation();
+        return angle >= _min_angle && angle <= _max_angle;
+      });
+    }
+    return ret;
+  }
+
+  /**
+   * \brief  Indices of all regions passing every predicate
+   */
+  std::vector<size_t> operator()(const Labeling & labeling) const {
+    auto ret = (*this)(labeling.stats);
+    if (_min_solidity > 0.) {
+      keep(ret, [&](size_t n) {
+        return regions::solidity(labeling, n) >= _min_solidity;
+      });
+    }
+    return ret;
+  }
+
+private:
+  template <class PredicateT>
+  static void keep(std::vector<size_t> & indices, PredicateT && predicate) {
+    indices.erase(std::remove_if(indices.begin(),
+                                 indices.end(),
+                                 [&](size_t n) { return !predicate(n); }),
+                  indices.end());
+  }
+
+  uint64_t _min_area{0};
+  uint64_t _max_area{std::numeric_limits<uint64_t>::max()};
+  double   _max_aspect{std::numeric_limits<double>::max()};
+  double   _min_fill{0.};
+  double   _max_fill{1.};
+  bool     _orientation{false};
+  double   _min_angle{0.};
+  double   _max_angle{0.};
+  double   _min_solidity{0.};
+};
+
+/**
+ * Indices of the regions passing the size check of filter below, decided
+ * on labeling statistics alone without building point lists
+ */
+inline std::vector<size_t> select(size_t img_size, const Statistics & stats) {
+  return Selection().area(img_size / 50, img_size / 10)(stats);
+}
+
 /**
  * Filter regions by size and dimensions
  */
@@ -9,6 +9,10 @@
 #ifndef BALKEN__TYPES_H__INCLUDED
 #define BALKEN__TYPES_H__INCLUDED
 
+// cpp
+#include <array>
+#include <cstddef>
+
 namespace balken {
 
 struct Point
@@ -21,6 +25,10 @@ struct Point
 };
 
 
+/**
+ * Oriented rectangle, U is the unit direction of the side from points[0]
+ * to points[1]
+ */
 struct Rectangle
 {
   std::array<float, 2> U;
@@ -7,22 +7,115 @@
  */
 
 // cpp
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
+#include <string>
+#include <vector>
 
 // external
 #include <blaze/math/DynamicMatrix.h>
 #include <blaze/math/Submatrix.h>
+#include <dmtx.h>
 #include <gtest/gtest.h>
 
 // own
 #include "datamatrix.h"
 #include "datamatrix_test.h"
+#include "ecc200.h"
+#include "finder.h"
 #include "histogram.h"
 #include "image.h"
+#include "image/geometry.h"
+#include "region/regions.h"
 
 using namespace balken;
 
+namespace {
+
+/**
+ * Symbol of text rendered by libdmtx with a white quiet zone, placed at
+ * (row, column) of a white image
+ */
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> encode(const std::string & text,
+                                                      size_t        rows,
+                                                      size_t        columns,
+                                                      size_t        row,
+                                                      size_t        column) {
+  auto bytes = std::vector<unsigned char>(text.begin(), text.end());
+
+  DmtxEncode * enc = dmtxEncodeCreate();
+  dmtxEncodeSetProp(enc, DmtxPropPixelPacking, DmtxPack8bppK);
+  dmtxEncodeDataMatrix(enc, static_cast<int>(bytes.size()), bytes.data());
+
+  const int width  = dmtxImageGetProp(enc->image, DmtxPropWidth);
+  const int height = dmtxImageGetProp(enc->image, DmtxPropHeight);
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(rows, columns, 255);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      int value = 255;
+      dmtxImageGetPixelValue(enc->image, x, y, 0, &value);
+      // libdmtx counts y from the bottom row
+      img(row + height - 1 - y, column + x) = static_cast<uint8_t>(value);
+    }
+  }
+  dmtxEncodeDestroy(&enc);
+  return img;
+}
+
+/**
+ * "123456" in a 10x10 symbol with finder pattern and timing border
+ */
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> symbol_123456() {
+  const auto * symbol = ecc200::find(10, 10);
+  const auto * table  = ecc200::placement(*symbol);
+
+  const uint8_t codewords[8] = {142, 164, 186, 114, 25, 5, 88, 102};
+  auto code = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(10, 10, 0);
+  for (size_t k = 0; k < 8; ++k) {
+    for (size_t b = 0; b < 8; ++b) {
+      const auto & m        = table[k * 8 + b];
+      code(m.row, m.column) = (codewords[k] >> (7 - b)) & 1;
+    }
+  }
+  for (size_t n = 0; n < 10; ++n) {
+    code(n, 0) = 1;
+    code(9, n) = 1;
+    code(0, n) = 1 - n % 2;
+    code(n, 9) = n % 2;
+  }
+  return code;
+}
+
+/**
+ * Paint the dark modules of code densely through the homography of corners
+ * into a white image
+ */
+blaze::DynamicMatrix<uint8_t, blaze::rowMajor> render(
+  const blaze::DynamicMatrix<uint8_t, blaze::rowMajor> & code,
+  const std::array<Point, 4> &                           corners,
+  size_t                                                 rows,
+  size_t                                                 columns) {
+  const auto H   = geometry::homography(corners);
+  auto       img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(
+    rows, columns, 220);
+  const auto steps = 40 * code.rows();
+  for (size_t r = 0; r < steps; ++r) {
+    for (size_t c = 0; c < steps; ++c) {
+      const auto p = H((c + 0.5) / steps, (r + 0.5) / steps);
+      if (code(r * code.rows() / steps, c * code.columns() / steps)) {
+        img(static_cast<size_t>(std::lround(p[0])),
+            static_cast<size_t>(std::lround(p[1]))) = 30;
+      }
+    }
+  }
+  return img;
+}
+
+}  // namespace
+
 TEST_F(DatamatrixTest, find) {
   auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{{0, 1}, {0, 0}};
   auto top_left = datamatrix::detail::find_top_left_black(img);  // < (1, 0)
@@ -227,3 +320,184 @@ TEST_F(DatamatrixTest, image) {
   // Size
   ASSERT_EQ(fwd.size(), 4);
 }
+
+TEST_F(DatamatrixTest, dmtx_decoder) {
+  const auto text  = std::string("balken 0123");
+  const auto bytes = std::vector<uint8_t>(text.begin(), text.end());
+  auto       img   = encode(text, 200, 300, 40, 120);
+
+  auto decoder = datamatrix::DmtxDecoder();
+  ASSERT_EQ(decoder(img), bytes);
+
+  // Region of interest around the symbol, searched twice with the same
+  // handles
+  ASSERT_EQ(decoder(img, 20, 100, 150, 150), bytes);
+  ASSERT_EQ(decoder(img, 20, 100, 150, 150), bytes);
+
+  // Region of interest without a symbol
+  ASSERT_TRUE(decoder(img, 0, 0, 40, 100).empty());
+  ASSERT_EQ(datamatrix::dmtx_decode(img), bytes);
+}
+
+TEST_F(DatamatrixTest, reed_solomon) {
+  // "123456" in a 10x10 symbol, ISO/IEC 16022 Annex O
+  const auto * symbol = ecc200::find(10, 10);
+  ASSERT_NE(symbol, nullptr);
+  ASSERT_EQ(symbol->data, 3);
+  ASSERT_EQ(symbol->ecc, 5);
+  ASSERT_EQ(ecc200::find(10, 12), nullptr);
+
+  const uint8_t expected[8] = {142, 164, 186, 114, 25, 5, 88, 102};
+  uint8_t       codewords[8];
+  std::copy_n(expected, 8, codewords);
+  ASSERT_TRUE(ecc200::correct(*symbol, codewords));
+
+  // Two errors are correctable with five ECC codewords
+  codewords[0] ^= 0x21;
+  codewords[6] = 0;
+  ASSERT_TRUE(ecc200::correct(*symbol, codewords));
+  ASSERT_TRUE(std::equal(expected, expected + 3, codewords));
+
+  auto out = std::vector<uint8_t>();
+  ASSERT_TRUE(ecc200::decode_data(codewords, symbol->data, out));
+  ASSERT_EQ(std::string(out.begin(), out.end()), "123456");
+}
+
+TEST_F(DatamatrixTest, encodation) {
+  auto decode = [](std::vector<uint8_t> data) {
+    auto out = std::vector<uint8_t>();
+    EXPECT_TRUE(ecc200::decode_data(data.data(), data.size(), out));
+    return std::string(out.begin(), out.end());
+  };
+
+  // C40 and Text, unlatch to ASCII and padding
+  ASSERT_EQ(decode({230, 91, 11, 91, 11, 91, 11, 254, 66, 129, 56}),
+            "AIMAIMAIMA");
+  ASSERT_EQ(decode({239, 91, 11, 91, 11, 91, 11}), "aimaimaim");
+
+  // Base 256 with randomized length and bytes
+  ASSERT_EQ(decode({231, 47, 34, 185, 79, 66}), "abcA");
+
+  // Upper shift
+  ASSERT_EQ(decode({235, 66}), "\xC1");
+
+  // C40 and Text pairs outside of 1 ... 64000 are invalid
+  auto          out     = std::vector<uint8_t>();
+  const uint8_t zero[]  = {239, 0, 0};
+  const uint8_t above[] = {230, 250, 1, 254};
+  const uint8_t max[]   = {230, 255, 255};
+  ASSERT_FALSE(ecc200::decode_data(zero, 3, out));
+  ASSERT_FALSE(ecc200::decode_data(above, 4, out));
+  ASSERT_FALSE(ecc200::decode_data(max, 3, out));
+}
+
+TEST_F(DatamatrixTest, placement) {
+  const auto * symbol = ecc200::find(10, 10);
+  const auto * table  = ecc200::placement(*symbol);
+
+  // First codeword wraps around the left edge of the mapping matrix
+  ASSERT_EQ(table[0].row, 3);
+  ASSERT_EQ(table[0].column, 7);
+  ASSERT_EQ(table[7].row, 5);
+  ASSERT_EQ(table[7].column, 1);
+
+  // Scatter "123456" with its ECC codewords into a symbol
+  const uint8_t codewords[8] = {142, 164, 186, 114, 25, 5, 88, 102};
+  auto code = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(10, 10, 0);
+  for (size_t k = 0; k < 8; ++k) {
+    for (size_t b = 0; b < 8; ++b) {
+      const auto & m        = table[k * 8 + b];
+      code(m.row, m.column) = (codewords[k] >> (7 - b)) & 1;
+    }
+  }
+
+  auto gathered = std::array<uint8_t, 8>();
+  ecc200::gather(code, *symbol, gathered.data());
+  ASSERT_TRUE(std::equal(codewords, codewords + 8, gathered.begin()));
+
+  auto payload = datamatrix::decode(code);
+  ASSERT_EQ(std::string(payload.begin(), payload.end()), "123456");
+
+  // A flipped module is corrected
+  code(4, 4) ^= 1;
+  payload = datamatrix::decode(code);
+  ASSERT_EQ(std::string(payload.begin(), payload.end()), "123456");
+}
+
+TEST_F(DatamatrixTest, sample) {
+  const auto code = symbol_123456();
+
+  // Tilted symbol in perspective
+  const auto corners = std::array<Point, 4>{
+    {Point(30, 40), Point(20, 150), Point(170, 165), Point(160, 30)}};
+  const auto at = geometry::homography(corners)(1, 1);
+  ASSERT_NEAR(at[0], 170, 1e-9);
+  ASSERT_NEAR(at[1], 165, 1e-9);
+
+  auto img     = render(code, corners, 200, 200);
+  auto sampled = datamatrix::sample(img, corners, 10, 10);
+  ASSERT_EQ(sampled, code);
+
+  auto payload = datamatrix::decode(sampled);
+  ASSERT_EQ(std::string(payload.begin(), payload.end()), "123456");
+
+  // Collinear corners and a crossed quadrilateral have no proper mapping
+  const auto line = std::array<Point, 4>{
+    {Point(50, 0), Point(50, 10), Point(50, 30), Point(50, 5)}};
+  const auto crossed = std::array<Point, 4>{
+    {Point(0, 0), Point(0, 100), Point(100, 0), Point(100, 100)}};
+  ASSERT_FALSE(geometry::homography(line).valid());
+  ASSERT_FALSE(geometry::homography(crossed).valid());
+  ASSERT_EQ(geometry::sample(img, line, 10, 10).rows(), 0);
+  ASSERT_EQ(geometry::sample(img, crossed, 10, 10).rows(), 0);
+  ASSERT_EQ(datamatrix::sample(img, line, 10, 10).rows(), 0);
+  ASSERT_TRUE(datamatrix::decode(datamatrix::sample(img, line, 10, 10))
+                .empty());
+
+  // Empty images read as 0
+  auto empty = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>();
+  ASSERT_EQ(geometry::detail::bilinear(empty, 1., 2.), 0.F);
+}
+
+TEST_F(DatamatrixTest, finder) {
+  // Symbol of 100 pixels, rotated by about 20 degrees, L in the bottom left
+  const auto corners = std::array<Point, 4>{
+    {Point(40, 70), Point(74, 164), Point(168, 130), Point(134, 36)}};
+  const auto img = render(symbol_123456(), corners, 200, 200);
+
+  // Candidate with a margin, starting at any corner in either direction
+  auto hull = std::vector<Point>{
+    Point(30, 64), Point(70, 174), Point(178, 136), Point(138, 26)};
+  auto find = finder::Finder();
+  for (size_t start = 0; start < 4; ++start) {
+    for (const bool reverse : {false, true}) {
+      auto rectangle = regions::minimal_bounding_rectangle(hull);
+      if (reverse) {
+        std::reverse(rectangle.points.begin(), rectangle.points.end());
+      }
+      std::rotate(rectangle.points.begin(),
+                  rectangle.points.begin() + start,
+                  rectangle.points.end());
+
+      const auto location = find(img, rectangle);
+      ASSERT_TRUE(location);
+      ASSERT_EQ(location.symbol, ecc200::find(10, 10));
+      for (size_t k = 0; k < 4; ++k) {
+        ASSERT_NEAR(location.corners[k].i, corners[k].i, 3);
+        ASSERT_NEAR(location.corners[k].j, corners[k].j, 3);
+      }
+
+      auto payload = datamatrix::decode(
+        datamatrix::sample(img, location.corners, 10, 10));
+      ASSERT_EQ(std::string(payload.begin(), payload.end()), "123456");
+    }
+  }
+
+  // Uniform and striped candidates are rejected
+  auto flat = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(200, 200, 220);
+  ASSERT_FALSE(find(flat, regions::minimal_bounding_rectangle(hull)));
+  for (size_t i = 0; i < 200; ++i) {
+    for (size_t j = 0; j < 200; ++j) { flat(i, j) = (j / 10) % 2 ? 30 : 220; }
+  }
+  ASSERT_FALSE(find(flat, regions::minimal_bounding_rectangle(hull)));
+}
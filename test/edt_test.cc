@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+// cpp
+#include <cstdint>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+#include <gtest/gtest.h>
+
+// own
+#include "arena.h"
+#include "edt_test.h"
+#include "image/edt.h"
+
+using namespace balken;
+
+TEST_F(EdtTest, metrics) {
+  // Single background pixel in the center of a 5x7 object
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(5, 7, 0);
+  img(2, 3) = 255;
+
+  auto l1 = edt::transform(img, edt::Metric::manhattan);
+  auto l8 = edt::transform(img, edt::Metric::chessboard);
+  auto l2 = edt::transform(img, edt::Metric::euclidean);
+
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      auto p  = std::make_pair(i, j);
+      auto c  = std::make_pair(size_t{2}, size_t{3});
+      auto di = static_cast<int>(i) - 2;
+      auto dj = static_cast<int>(j) - 3;
+      ASSERT_EQ(l1(i, j), edt::detail::manhattan_distance(p, c));
+      ASSERT_EQ(l8(i, j), edt::detail::chessboard_distance(p, c));
+      ASSERT_EQ(l2(i, j), static_cast<uint32_t>(di * di + dj * dj));
+    }
+  }
+
+  auto pruned = edt::prune(l2);
+  ASSERT_EQ(pruned(2, 3), 255);
+  ASSERT_EQ(pruned(0, 0), 0);
+}
+
+TEST_F(EdtTest, parallel) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(37, 131, 0);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = (i * 7 + j * 13) % 23 == 0 ? 255 : 0;
+    }
+  }
+
+  parallel::ThreadPool pool(3);
+  for (auto metric : {edt::Metric::manhattan, edt::Metric::euclidean}) {
+    auto serial   = edt::transform(img, metric);
+    auto threaded = edt::transform(img, metric, pool);
+    for (size_t i = 0; i < img.rows(); ++i) {
+      for (size_t j = 0; j < img.columns(); ++j) {
+        ASSERT_EQ(serial(i, j), threaded(i, j));
+      }
+    }
+  }
+}
+
+TEST_F(EdtTest, arena) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(29, 53, 0);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = (i * 5 + j * 11) % 19 == 0 ? 255 : 0;
+    }
+  }
+
+  auto frame = arena::FrameArena(1 << 10);
+  for (int f = 0; f < 2; ++f) {
+    frame.reset();
+    for (auto metric : {edt::Metric::manhattan,
+                        edt::Metric::chessboard,
+                        edt::Metric::euclidean}) {
+      auto expected = edt::transform(img, metric);
+      auto dm       = edt::transform(img, metric, frame);
+      ASSERT_EQ(dm.rows(), img.rows());
+      ASSERT_EQ(dm.columns(), img.columns());
+      for (size_t i = 0; i < img.rows(); ++i) {
+        for (size_t j = 0; j < img.columns(); ++j) {
+          ASSERT_EQ(dm(i, j), expected(i, j));
+        }
+      }
+    }
+  }
+}
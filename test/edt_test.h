@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__EDT_TEST_H__INCLUDED
+#define BALKEN__EDT_TEST_H__INCLUDED
+
+#include <gtest/gtest.h>
+#include "TestBase.h"
+
+class EdtTest : public ::testing::Test
+{
+public:
+  EdtTest() { LOG_MESSAGE("Opening test suite: EdtTest"); }
+
+  virtual ~EdtTest() { LOG_MESSAGE("Closing test suite: EdtTest"); }
+
+  virtual void SetUp() {}
+
+  virtual void TearDown() {}
+};
+
+#endif  // BALKEN__EDT_TEST_H__INCLUDED
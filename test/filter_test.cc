@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+// cpp
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+#include <gtest/gtest.h>
+
+// own
+#include "filter_test.h"
+#include "image/filter.h"
+#include "image/integral.h"
+
+using namespace balken;
+
+TEST_F(FilterTest, separable) {
+  ASSERT_FALSE(filter::make_separable(filter::detail::gauss_3x3).empty());
+  ASSERT_FALSE(filter::make_separable(filter::detail::sobel_x).empty());
+  ASSERT_FALSE(filter::make_separable(filter::detail::sobel_y).empty());
+  ASSERT_TRUE(filter::make_separable(filter::detail::sobel_45).empty());
+
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(16, 48);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * 71 + j * j * 13) % 256);
+    }
+  }
+
+  auto gauss       = filter::convolve(img, filter::detail::gauss_3x3);
+  auto gauss_float = filter::convolve_float(img, filter::detail::gauss_3x3);
+  auto sobel       = filter::convolve(img, filter::detail::sobel_x);
+  auto sobel_float = filter::convolve_float(img, filter::detail::sobel_x);
+
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(gauss(i, j), gauss_float(i, j));
+      ASSERT_EQ(sobel(i, j), sobel_float(i, j));
+    }
+  }
+
+  // Last row and column are covered as well
+  ASSERT_NE(gauss(img.rows() - 2, img.columns() - 2), 0);
+  ASSERT_EQ(gauss(img.rows() - 1, img.columns() - 1), 0);
+}
+
+TEST_F(FilterTest, adaptive) {
+  // Dark text on a background getting brighter from left to right
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(40, 120);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>(60 + j + (i * 7 + j * 3) % 5);
+      if (i % 10 == 5 && j % 10 < 3) { img(i, j) -= 40; }
+    }
+  }
+
+  const size_t radius = 4;
+  for (auto method : {filter::views::Adaptive::bradley,
+                      filter::views::Adaptive::sauvola}) {
+    const float k      = 0.1F;
+    auto        binary = filter::views::AdaptiveBinaryView<decltype(img)>(
+      img, radius, k, method);
+    for (size_t i = 0; i < img.rows(); ++i) {
+      for (size_t j = 0; j < img.columns(); ++j) {
+        // Brute force window statistics
+        float  sum = 0, squares = 0, area = 0;
+        size_t i0  = i > radius ? i - radius : 0;
+        size_t j0  = j > radius ? j - radius : 0;
+        for (size_t h = i0; h < std::min(img.rows(), i + radius + 1); ++h) {
+          for (size_t w = j0; w < std::min(img.columns(), j + radius + 1);
+               ++w) {
+            sum += img(h, w);
+            squares += img(h, w) * img(h, w);
+            area += 1;
+          }
+        }
+        const float mean      = sum / area;
+        const float deviation = std::sqrt(squares / area - mean * mean);
+        const float threshold =
+          method == filter::views::Adaptive::bradley
+            ? mean * (1 - k)
+            : mean * (1 + k * (deviation / 128 - 1));
+        // Skip values too close to the threshold for float rounding
+        if (std::abs(img(i, j) - threshold) < 0.01F) { continue; }
+        ASSERT_EQ(binary(i, j), img(i, j) > threshold ? 255 : 0);
+      }
+    }
+
+    // The dark marks are found on both ends of the gradient
+    ASSERT_EQ(binary(15, 1), 0);
+    ASSERT_EQ(binary(15, 111), 0);
+    ASSERT_EQ(binary(12, 111), 255);
+  }
+
+  // A global threshold fails on the bright end
+  auto global = filter::views::binarize(img, 100);
+  ASSERT_EQ(global(15, 111), 255);
+  ASSERT_EQ(filter::views::bradley(img, 7)(15, 111), 0);
+  ASSERT_EQ(filter::views::sauvola(img, 7)(15, 111), 0);
+}
+
+TEST_F(FilterTest, integral) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(23, 37);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * i * 13 + j * 71) % 256);
+    }
+  }
+
+  auto sums = integral::IntegralImage<uint64_t>(img, true);
+  ASSERT_TRUE(sums.has_squares());
+  ASSERT_FALSE(integral::IntegralImage<>(img).has_squares());
+  for (size_t i0 = 0; i0 < img.rows(); i0 += 5) {
+    for (size_t j0 = 0; j0 < img.columns(); j0 += 3) {
+      const size_t i1  = std::min(img.rows(), i0 + 7);
+      const size_t j1  = std::min(img.columns(), j0 + 11);
+      uint64_t     sum = 0, squares = 0;
+      for (size_t i = i0; i < i1; ++i) {
+        for (size_t j = j0; j < j1; ++j) {
+          sum += img(i, j);
+          squares += img(i, j) * img(i, j);
+        }
+      }
+      const float area = static_cast<float>((i1 - i0) * (j1 - j0));
+      ASSERT_EQ(sums.sum(i0, j0, i1, j1), sum);
+      ASSERT_EQ(sums.squares(i0, j0, i1, j1), squares);
+      ASSERT_FLOAT_EQ(sums.mean(i0, j0, i1, j1), sum / area);
+      ASSERT_NEAR(sums.variance(i0, j0, i1, j1),
+                  squares / area - (sum / area) * (sum / area),
+                  0.1);
+    }
+  }
+
+  const size_t radius = 2;
+  auto         box    = integral::box(img, radius);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      uint32_t sum = 0, area = 0;
+      for (size_t h = i > radius ? i - radius : 0;
+           h < std::min(img.rows(), i + radius + 1);
+           ++h) {
+        for (size_t w = j > radius ? j - radius : 0;
+             w < std::min(img.columns(), j + radius + 1);
+             ++w) {
+          sum += img(h, w);
+          ++area;
+        }
+      }
+      ASSERT_EQ(box(i, j), (sum + area / 2) / area);
+    }
+  }
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+// cpp
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+#include <gtest/gtest.h>
+
+// own
+#include "arena.h"
+#include "histogram_test.h"
+#include "image/filter.h"
+#include "image/histogram.h"
+#include "image/lut.h"
+#include "image/view.h"
+#include "parallel.h"
+
+using namespace balken;
+
+TEST_F(HistogramTest, count) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(37, 61);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      // Long runs of equal values next to varying ones
+      img(i, j) = j < 20 ? 7 : static_cast<uint8_t>((i * 17 + j * j) % 256);
+    }
+  }
+
+  auto expected = histogram::Counts();
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) { ++expected[img(i, j)]; }
+  }
+
+  parallel::ThreadPool pool(3);
+  ASSERT_EQ(histogram::count(img), expected);
+  ASSERT_EQ(histogram::count(img, pool), expected);
+  ASSERT_EQ(histogram::count(histogram::views::stretch(img)),
+            histogram::count(histogram::views::stretch(img), pool));
+
+  auto hist = histogram::normalize(expected);
+  ASSERT_FLOAT_EQ(hist[7], expected[7] / static_cast<float>(37 * 61));
+  ASSERT_GE(expected[7], 20U * 37);
+  ASSERT_EQ(histogram::normalize(histogram::Counts())[0], 0);
+}
+
+TEST_F(HistogramTest, lut) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(13, 71);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>(40 + (i * 131 + j * 7) % 150);
+    }
+  }
+
+  // Table application on every value and on an odd tail
+  auto table = lut::Lut();
+  for (int v = 0; v < 256; ++v) { table[v] = static_cast<uint8_t>(v * 37); }
+  auto values = std::vector<uint8_t>(301);
+  auto mapped = std::vector<uint8_t>(301);
+  for (size_t v = 0; v < values.size(); ++v) { values[v] = v * 11 % 256; }
+  table.apply(values.data(), mapped.data(), values.size());
+  for (size_t v = 0; v < values.size(); ++v) {
+    ASSERT_EQ(mapped[v], static_cast<uint8_t>(values[v] * 37));
+  }
+
+  // Lazy stretch matches the old per pixel formula, binarizing is fused
+  auto stretched = histogram::views::stretch(img);
+  auto binary    = filter::views::binarize(stretched, 100);
+  auto factor    = 255 / static_cast<float>(189 - 40);
+  auto tiled     = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(13, 71);
+  view::materialize(binary, tiled);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      auto s = static_cast<uint8_t>((img(i, j) - 40) * factor);
+      ASSERT_EQ(stretched(i, j), s);
+      ASSERT_EQ(binary(i, j), s > 100 ? 255 : 0);
+      ASSERT_EQ(tiled(i, j), binary(i, j));
+    }
+  }
+
+  // Eager versions
+  auto copy = img;
+  histogram::stretch(copy);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(copy(i, j), stretched(i, j));
+    }
+  }
+
+  auto hist = histogram::detail::generate(img);
+  auto cum  = histogram::detail::accumulate(hist);
+  copy = img;
+  histogram::equalize(copy);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(copy(i, j),
+                static_cast<uint8_t>(floor(255 * cum[img(i, j)])));
+    }
+  }
+}
+
+TEST_F(HistogramTest, arena) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(23, 47);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>(30 + (i * 13 + j * j) % 180);
+    }
+  }
+
+  auto frame = arena::FrameArena(1 << 8);
+  for (int f = 0; f < 2; ++f) {
+    frame.reset();
+    ASSERT_EQ(histogram::count(img, frame), histogram::count(img));
+    // Views are read through a line buffer from the arena
+    ASSERT_EQ(histogram::count(histogram::views::stretch(img), frame),
+              histogram::count(histogram::views::stretch(img)));
+  }
+  ASSERT_GT(frame.used(), 0U);
+
+  auto empty = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(0, 0);
+  ASSERT_EQ(histogram::count(empty, frame), histogram::Counts());
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__HISTOGRAM_TEST_H__INCLUDED
+#define BALKEN__HISTOGRAM_TEST_H__INCLUDED
+
+#include <gtest/gtest.h>
+#include "TestBase.h"
+
+class HistogramTest : public ::testing::Test
+{
+public:
+  HistogramTest() { LOG_MESSAGE("Opening test suite: HistogramTest"); }
+
+  virtual ~HistogramTest() { LOG_MESSAGE("Closing test suite: HistogramTest"); }
+
+  virtual void SetUp() {}
+
+  virtual void TearDown() {}
+};
+
+#endif  // BALKEN__HISTOGRAM_TEST_H__INCLUDED
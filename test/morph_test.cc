@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+// cpp
+#include <cstdint>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+#include <gtest/gtest.h>
+
+// own
+#include "arena.h"
+#include "image/filter.h"
+#include "image/histogram.h"
+#include "image/morph.h"
+#include "image/pipeline.h"
+#include "image/view.h"
+#include "morph_test.h"
+#include "parallel.h"
+
+using namespace balken;
+
+TEST_F(MorphTest, rectangular) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(9, 11);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * 37 + j * 101) % 256);
+    }
+  }
+
+  // Kernel of ones with a single hole forces the generic path
+  auto ones  = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(3, 5, 1);
+  auto holed = ones;
+  holed(0, 0) = 0;
+  ASSERT_TRUE(morph::detail::is_rectangular(ones));
+  ASSERT_FALSE(morph::detail::is_rectangular(holed));
+
+  auto eroded  = morph::erode(img, morph::rectangle(3, 5));
+  auto dilated = morph::dilate(img, ones);
+
+  for (size_t i = 1; i < img.rows() - 1; ++i) {
+    for (size_t j = 2; j < img.columns() - 2; ++j) {
+      uint8_t min = 255;
+      uint8_t max = 0;
+      for (size_t h = 0; h < 3; ++h) {
+        for (size_t w = 0; w < 5; ++w) {
+          min = std::min(min, img(i + h - 1, j + w - 2));
+          max = std::max(max, img(i + h - 1, j + w - 2));
+        }
+      }
+      ASSERT_EQ(eroded(i, j), min);
+      ASSERT_EQ(dilated(i, j), max);
+    }
+  }
+
+  // Neighborhood leaves the image
+  ASSERT_EQ(eroded(0, 5), 0);
+  ASSERT_EQ(dilated(4, 1), 0);
+}
+
+TEST_F(MorphTest, materialize) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(12, 40);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * 53 + j * 29) % 256);
+    }
+  }
+  auto cross = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {0, 1, 0}, {1, 1, 1}, {0, 1, 0}};
+
+  auto eroded  = morph::views::erode(img, cross);
+  auto dilated = morph::views::dilate(img, cross);
+  auto e       = morph::views::materialize(eroded);
+  auto d       = morph::views::materialize(dilated);
+
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(e(i, j), eroded(i, j));
+      ASSERT_EQ(d(i, j), dilated(i, j));
+    }
+  }
+}
+
+TEST_F(MorphTest, tiled) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(70, 90);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * i * 7 + j * 13 + i * j) % 256);
+    }
+  }
+  auto cross = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {0, 1, 0}, {1, 1, 1}, {0, 1, 0}};
+  auto wide = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {1, 0, 1, 1, 0}, {0, 1, 1, 1, 1}, {1, 1, 0, 1, 1}};
+
+  using namespace morph::adaptors;
+  auto chain = img | erode(cross) | dilate(wide) | erode(cross);
+
+  parallel::ThreadPool pool(3);
+  auto out      = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(70, 90);
+  auto parallel = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(70, 90);
+  view::materialize(chain, out);
+  view::materialize(chain, parallel, pool, 16, 24);
+
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(out(i, j), chain(i, j));
+      ASSERT_EQ(parallel(i, j), chain(i, j));
+    }
+  }
+}
+
+namespace {
+
+/**
+ * Image counting how often its elements are read
+ */
+class CountingView : public view::ViewBase<blaze::DynamicMatrix<uint8_t>,
+                                           CountingView>
+{
+public:
+  using ElementType = uint8_t;
+
+  CountingView(const blaze::DynamicMatrix<uint8_t> & img, size_t & reads)
+   : view::ViewBase<blaze::DynamicMatrix<uint8_t>, CountingView>(img),
+     _reads{reads} {}
+
+  uint8_t view_element(size_t i, size_t j) const {
+    ++_reads;
+    return _img(i, j);
+  }
+
+private:
+  size_t & _reads;
+};
+
+}  // namespace
+
+TEST_F(MorphTest, cache) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(20, 30);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * 31 + j * j * 3) % 256);
+    }
+  }
+  auto square = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(3, 3, 1);
+  square(0, 0) = 0;
+
+  size_t reads  = 0;
+  auto   cached = view::cache(CountingView(img, reads), 3);
+  auto   eroded = morph::views::erode(cached, square);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      uint8_t min = 255;
+      if (i >= 2 && i < img.rows() - 2 && j >= 2 && j < img.columns() - 2) {
+        for (size_t h = 0; h < 3; ++h) {
+          for (size_t w = 0; w < 3; ++w) {
+            if (square(h, w) == 1) {
+              min = std::min(min, img(i + h - 1, j + w - 1));
+            }
+          }
+        }
+      } else {
+        min = 0;
+      }
+      ASSERT_EQ(eroded(i, j), min);
+    }
+  }
+  // Every row of the input is evaluated once
+  ASSERT_EQ(reads, (img.rows() - 2) * img.columns());
+
+  // Neighborhood views on top of each other are cached automatically
+  using namespace morph::adaptors;
+  auto closed = img | dilate(square) | erode(square);
+  static_assert(
+    view::is_view<std::decay_t<decltype(closed)>>::value, "lazy closing");
+  auto expected = morph::views::materialize(
+    morph::views::erode(morph::views::materialize(img | dilate(square)),
+                        square));
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(closed(i, j), expected(i, j));
+    }
+  }
+}
+
+TEST_F(MorphTest, cache_invalidate) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(15, 21);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * 29 + j * 11) % 256);
+    }
+  }
+  auto square = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(3, 3, 1);
+
+  using namespace morph::adaptors;
+  auto closed = img | dilate(square) | erode(square);
+
+  // The same view reused for the next frame
+  for (int frame = 0; frame < 3; ++frame) {
+    for (size_t i = 0; i < img.rows(); ++i) {
+      for (size_t j = 0; j < img.columns(); ++j) {
+        img(i, j) = static_cast<uint8_t>(img(i, j) * 7 + frame);
+      }
+    }
+    closed.invalidate();
+
+    // Bottom rows first, they are still in the ring from the last frame
+    auto expected = morph::views::materialize(
+      morph::views::erode(morph::views::materialize(img | dilate(square)),
+                          square));
+    for (size_t i = img.rows(); i-- > 0;) {
+      for (size_t j = 0; j < img.columns(); ++j) {
+        ASSERT_EQ(closed(i, j), expected(i, j));
+      }
+    }
+  }
+}
+
+TEST_F(MorphTest, cache_interleaved) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(20, 30);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * 13 + j * j) % 256);
+    }
+  }
+  auto square = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(3, 3, 1);
+
+  // Two views of the same type read in alternation keep their own rows
+  size_t reads_a = 0;
+  size_t reads_b = 0;
+  auto   a = morph::views::erode(view::cache(CountingView(img, reads_a), 3),
+                               square);
+  auto   b = morph::views::erode(view::cache(CountingView(img, reads_b), 3),
+                               square);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) { ASSERT_EQ(a(i, j), b(i, j)); }
+  }
+  ASSERT_EQ(reads_a, (img.rows() - 2) * img.columns());
+  ASSERT_EQ(reads_b, (img.rows() - 2) * img.columns());
+}
+
+TEST_F(MorphTest, rectangular_adaptors) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(17, 23);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * 43 + j * j * 7) % 256);
+    }
+  }
+  auto ones = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(3, 5, 1);
+
+  // Chains on rectangle temporaries stay lazy and outlive the statement
+  using namespace morph::adaptors;
+  auto closed = img | dilate(morph::rectangle(3, 5)) |
+                erode(morph::rectangle(3, 5));
+  static_assert(
+    view::is_view<std::decay_t<decltype(closed)>>::value, "lazy closing");
+
+  auto expected = img | dilate(ones) | erode(ones);
+  auto out      = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(17, 23);
+  view::materialize(closed, out);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(closed(i, j), expected(i, j));
+      ASSERT_EQ(out(i, j), expected(i, j));
+    }
+  }
+}
+
+TEST_F(MorphTest, bottom_hat_pipeline) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(30, 40, 200);
+  // Dark bar on a bright background
+  for (size_t i = 12; i < 16; ++i) {
+    for (size_t j = 10; j < 30; ++j) { img(i, j) = 20; }
+  }
+  img(0, 0) = 0;
+
+  auto stretched = histogram::views::stretch(img);
+  auto closed    = morph::close(stretched, morph::rectangle(9, 9));
+  auto hat       = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(30, 40);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      hat(i, j) = std::max(0, closed(i, j) - stretched(i, j));
+    }
+  }
+  auto expected =
+    morph::dilate(filter::views::binarize(hat, 50), morph::rectangle(3, 5));
+
+  auto detect = pipeline::BottomHat(9, 9, 50, 3, 5);
+  auto mask   = detect(img);
+  ASSERT_EQ(mask(13, 20), 255);
+  ASSERT_EQ(mask(5, 20), 0);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(mask(i, j), expected(i, j));
+    }
+  }
+}
+
+TEST_F(MorphTest, arena) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(40, 60);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      img(i, j) = static_cast<uint8_t>((i * 17 + j * j * 5) % 256);
+    }
+  }
+  auto cross = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {0, 1, 0}, {1, 1, 1}, {0, 1, 0}};
+
+  auto frame = arena::FrameArena(1 << 10);
+  for (int f = 0; f < 3; ++f) {
+    frame.reset();
+    auto closed = morph::close(img, morph::rectangle(5, 7), frame);
+    auto opened = morph::open(img, cross, frame);
+
+    auto expected_closed = morph::close(img, morph::rectangle(5, 7));
+    auto expected_opened = morph::open(img, cross);
+    for (size_t i = 0; i < img.rows(); ++i) {
+      for (size_t j = 0; j < img.columns(); ++j) {
+        ASSERT_EQ(closed(i, j), expected_closed(i, j));
+        ASSERT_EQ(opened(i, j), expected_opened(i, j));
+      }
+    }
+  }
+
+  // After the first frame the blocks are coalesced and reused
+  const auto capacity = frame.capacity();
+  frame.reset();
+  morph::close(img, morph::rectangle(5, 7), frame);
+  morph::open(img, cross, frame);
+  ASSERT_EQ(frame.capacity(), capacity);
+  ASSERT_LE(frame.used(), capacity);
+}
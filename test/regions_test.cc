@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+// cpp
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// external
+#include <blaze/math/DynamicMatrix.h>
+#include <gtest/gtest.h>
+
+// own
+#include "arena.h"
+#include "region/compact.h"
+#include "region/regions.h"
+#include "regions_test.h"
+
+using namespace balken;
+
+TEST_F(RegionsTest, label) {
+  /* Two regions, the first one u-shaped so its arms get merged
+   * 1 0 1 0 0
+   * 1 0 1 0 1
+   * 1 1 1 0 1
+   */
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {255, 0, 255, 0, 0}, {255, 0, 255, 0, 255}, {255, 255, 255, 0, 255}};
+
+  auto labeling = regions::label(img);
+  ASSERT_EQ(labeling.size(), 2);
+
+  ASSERT_EQ(labeling.labels(0, 0), 1);
+  ASSERT_EQ(labeling.labels(0, 2), 1);
+  ASSERT_EQ(labeling.labels(1, 4), 2);
+  ASSERT_EQ(labeling.labels(0, 1), 0);
+
+  ASSERT_EQ(labeling.stats[0].area, 7);
+  ASSERT_EQ(labeling.stats[0].min.i, 0);
+  ASSERT_EQ(labeling.stats[0].max.i, 2);
+  ASSERT_EQ(labeling.stats[0].max.j, 2);
+  ASSERT_EQ(labeling.stats[1].area, 2);
+  ASSERT_DOUBLE_EQ(labeling.stats[1].centroid().first, 1.5);
+  ASSERT_DOUBLE_EQ(labeling.stats[1].centroid().second, 4.0);
+
+  auto points = regions::find(img);
+  ASSERT_EQ(points.size(), 2);
+  ASSERT_EQ(points[0].size(), 7);
+  ASSERT_EQ(points[1].size(), 2);
+}
+
+TEST_F(RegionsTest, run_length) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {255, 0, 255, 0, 0}, {255, 0, 255, 0, 255}, {255, 255, 255, 0, 255}};
+
+  auto runs = rle::encode(img);
+  ASSERT_EQ(runs.size(), 7);
+  ASSERT_EQ(runs(2, 1), 255);
+  ASSERT_EQ(runs(2, 3), 0);
+
+  auto decoded = rle::decode(runs);
+  for (size_t i = 0; i < img.rows(); ++i) {
+    for (size_t j = 0; j < img.columns(); ++j) {
+      ASSERT_EQ(decoded(i, j), img(i, j));
+    }
+  }
+
+  auto labeling = regions::label(runs);
+  ASSERT_EQ(labeling.size(), 2);
+  ASSERT_EQ(labeling.stats[0].area, 7);
+  ASSERT_EQ(labeling.stats[1].area, 2);
+  ASSERT_DOUBLE_EQ(labeling.stats[1].centroid().first, 1.5);
+
+  // Horizontal dilation joins the right column to the u-shape
+  auto dilated = rle::dilate(runs, 1, 3);
+  ASSERT_EQ(dilated(2, 3), 255);
+  ASSERT_EQ(regions::label(dilated).size(), 1);
+
+  // Empty images have no regions
+  auto empty = rle::encode(blaze::DynamicMatrix<uint8_t, blaze::rowMajor>());
+  ASSERT_EQ(empty.rows(), 0);
+  ASSERT_EQ(regions::label(empty).size(), 0);
+  ASSERT_TRUE(regions::label(empty).labels.empty());
+  auto blank =
+    rle::encode(blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(3, 4, 0));
+  ASSERT_EQ(regions::label(blank).size(), 0);
+}
+
+TEST_F(RegionsTest, minimal_bounding_rectangle) {
+  // Diamond, the axis-aligned box would have twice the area
+  auto diamond = std::vector<Point>{{0, 5}, {5, 10}, {10, 5}, {5, 0}};
+  auto rect    = regions::minimal_bounding_rectangle(diamond);
+  ASSERT_EQ(rect.area, 50);
+  ASSERT_NEAR(std::abs(rect.U[0]), std::sqrt(0.5F), 1e-5);
+  ASSERT_NEAR(std::abs(rect.U[1]), std::sqrt(0.5F), 1e-5);
+
+  auto box = std::vector<Point>{{0, 0}, {0, 4}, {3, 4}, {3, 0}};
+  rect     = regions::minimal_bounding_rectangle(box);
+  ASSERT_EQ(rect.area, 12);
+  for (size_t n = 0; n < 4; ++n) {
+    ASSERT_EQ(rect.points[n].i, box[n].i);
+    ASSERT_EQ(rect.points[n].j, box[n].j);
+  }
+
+  auto pentagon =
+    std::vector<Point>{{0, 0}, {2, 1}, {3, 3}, {1, 4}, {-1, 2}};
+  ASSERT_EQ(regions::minimal_bounding_rectangle(pentagon).area, 12);
+}
+
+TEST_F(RegionsTest, contour_hull) {
+  /* Ring with a spur, the hole and the spur must not confuse the hull
+   * 0 1 1 1 0 0
+   * 1 1 0 1 1 1
+   * 1 1 1 1 0 0
+   * 0 0 1 0 0 0
+   */
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {0, 255, 255, 255, 0, 0},
+    {255, 255, 0, 255, 255, 255},
+    {255, 255, 255, 255, 0, 0},
+    {0, 0, 255, 0, 0, 0}};
+
+  auto labeling = regions::label(img);
+  ASSERT_EQ(labeling.size(), 1);
+
+  auto border = regions::contour(labeling.labels, Point(0, 1));
+  ASSERT_EQ(border.front().i, 0);
+  ASSERT_EQ(border.front().j, 1);
+  for (const auto & p : border) { ASSERT_EQ(labeling.labels(p.i, p.j), 1); }
+
+  auto region   = regions::find(img)[0];
+  auto expected = regions::convex_hull(region);
+  auto hull     = regions::convex_hull(labeling, 0);
+  ASSERT_EQ(hull.size(), expected.size());
+  for (const auto & p : expected) {
+    ASSERT_TRUE(std::any_of(hull.begin(), hull.end(), [&](const Point & q) {
+      return p.i == q.i && p.j == q.j;
+    }));
+  }
+}
+
+TEST_F(RegionsTest, moments) {
+  /* Diagonal bar and a filled square
+   * 1 1 0 0 0 0 0
+   * 0 1 1 0 1 1 1
+   * 0 0 1 0 1 1 1
+   * 0 0 0 0 1 1 1
+   */
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {255, 255, 0, 0, 0, 0, 0},
+    {0, 255, 255, 0, 255, 255, 255},
+    {0, 0, 255, 0, 255, 255, 255},
+    {0, 0, 0, 0, 255, 255, 255}};
+
+  auto labeling = regions::label(img);
+  ASSERT_EQ(labeling.size(), 2);
+
+  auto bar = labeling.stats[0];
+  ASSERT_EQ(bar.area, 5);
+  ASSERT_DOUBLE_EQ(bar.centroid().first, 0.8);
+  ASSERT_DOUBLE_EQ(bar.centroid().second, 1.2);
+  ASSERT_DOUBLE_EQ(bar.fill_ratio(), 5. / 9.);
+  // Major axis runs down to the right
+  ASSERT_GT(bar.orientation(), 0.);
+  ASSERT_LT(bar.orientation(), std::acos(0.));
+  ASSERT_GT(bar.eccentricity(), 0.8);
+
+  auto square = labeling.stats[1];
+  ASSERT_EQ(square.area, 9);
+  ASSERT_NEAR(square.mu_ii, 2. / 3., 1e-9);
+  ASSERT_NEAR(square.mu_ij, 0., 1e-9);
+  ASSERT_NEAR(square.eccentricity(), 0., 1e-6);
+  ASSERT_DOUBLE_EQ(square.fill_ratio(), 1.);
+
+  // Both regions pass for a 100 pixel image, only the bar for 60
+  ASSERT_EQ(regions::select(100, labeling.stats).size(), 2);
+  auto kept = regions::select(60, labeling.stats);
+  ASSERT_EQ(kept.size(), 1);
+  ASSERT_EQ(kept[0], 0);
+
+  auto points = regions::points(labeling, kept);
+  ASSERT_EQ(points.size(), 1);
+  ASSERT_EQ(points[0].size(), 5);
+}
+
+TEST_F(RegionsTest, selection) {
+  /* U-shape, filled square and a horizontal bar
+   * 1 0 1 0 1 1 0 0 0 0
+   * 1 0 1 0 1 1 0 1 1 1
+   * 1 1 1 0 0 0 0 0 0 0
+   */
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {255, 0, 255, 0, 255, 255, 0, 0, 0, 0},
+    {255, 0, 255, 0, 255, 255, 0, 255, 255, 255},
+    {255, 255, 255, 0, 0, 0, 0, 0, 0, 0}};
+
+  auto labeling = regions::label(img);
+  ASSERT_EQ(labeling.size(), 3);
+  ASSERT_EQ(regions::hull_pixels(regions::convex_hull(labeling, 0)), 9);
+  ASSERT_DOUBLE_EQ(regions::solidity(labeling, 0), 7. / 9.);
+  ASSERT_DOUBLE_EQ(regions::solidity(labeling, 1), 1.);
+
+  ASSERT_EQ(regions::Selection()(labeling).size(), 3);
+  ASSERT_EQ(regions::Selection().area(4, 10)(labeling).size(), 2);
+  ASSERT_EQ(regions::Selection().aspect(2.)(labeling).size(), 2);
+  ASSERT_EQ(regions::Selection().fill_ratio(0.9)(labeling).size(), 2);
+
+  auto compact = regions::Selection().solidity(0.9).area(3, 10)(labeling);
+  ASSERT_EQ(compact.size(), 2);
+  ASSERT_EQ(compact[0], 1);
+  ASSERT_EQ(compact[1], 2);
+
+  // All regions are symmetric, their major axes are horizontal
+  auto flat = regions::Selection().orientation(-0.1, 0.1).fill_ratio(0.9);
+  ASSERT_EQ(flat(labeling.stats).size(), 2);
+  ASSERT_EQ(regions::Selection().orientation(0.1, 1.6)(labeling).size(), 0);
+}
+
+TEST_F(RegionsTest, compact) {
+  auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>{
+    {255, 0, 255, 0, 255, 255, 0, 0, 0, 0},
+    {255, 0, 255, 0, 255, 255, 0, 255, 255, 255},
+    {255, 255, 255, 0, 0, 0, 0, 0, 0, 0}};
+
+  auto labeling = regions::label(img);
+  auto vectors  = regions::points(labeling);
+  auto all      = regions::compact(labeling);
+  ASSERT_EQ(all.size(), 3);
+  ASSERT_EQ(all.points(), 14);
+  for (size_t n = 0; n < all.size(); ++n) {
+    ASSERT_EQ(all[n].size(), vectors[n].size());
+    for (size_t k = 0; k < vectors[n].size(); ++k) {
+      ASSERT_EQ(all[n][k].i, vectors[n][k].i);
+      ASSERT_EQ(all[n][k].j, vectors[n][k].j);
+    }
+
+    auto box      = regions::bounding_box(all[n]);
+    auto expected = regions::bounding_box(vectors[n]);
+    ASSERT_EQ(box[0].i, expected[0].i);
+    ASSERT_EQ(box[2].j, expected[2].j);
+    ASSERT_EQ(regions::convex_hull(all[n]).size(),
+              regions::convex_hull(vectors[n]).size());
+  }
+
+  auto selected = regions::compact(labeling, {2});
+  ASSERT_EQ(selected.size(), 1);
+  ASSERT_EQ(selected[0].front().j, 7);
+  ASSERT_EQ(selected[0].back().j, 9);
+  ASSERT_EQ(regions::from_regions(img, selected)(1, 8), 1);
+}
+
+TEST_F(RegionsTest, label_arena) {
+  auto frame    = arena::FrameArena(1 << 8);
+  auto labeling = regions::Labeling();
+
+  // Frames of different sizes and label counts through one labeling
+  for (size_t n : {3, 11, 1, 7}) {
+    auto img = blaze::DynamicMatrix<uint8_t, blaze::rowMajor>(
+      4 * n + 3, 30 - 2 * n, 0);
+    for (size_t i = 0; i < img.rows(); ++i) {
+      for (size_t j = 0; j < img.columns(); ++j) {
+        if ((i * n + j * 5) % 7 < 3) { img(i, j) = 255; }
+      }
+    }
+
+    frame.reset();
+    regions::label(img, labeling, frame);
+    auto expected = regions::label(img);
+
+    ASSERT_EQ(labeling.labels.rows(), img.rows());
+    ASSERT_EQ(labeling.labels.columns(), img.columns());
+    ASSERT_EQ(labeling.size(), expected.size());
+    for (size_t i = 0; i < img.rows(); ++i) {
+      for (size_t j = 0; j < img.columns(); ++j) {
+        ASSERT_EQ(labeling.labels(i, j), expected.labels(i, j));
+      }
+    }
+    for (size_t k = 0; k < expected.size(); ++k) {
+      ASSERT_EQ(labeling.stats.area[k], expected.stats.area[k]);
+      ASSERT_EQ(labeling.stats.min_i[k], expected.stats.min_i[k]);
+      ASSERT_EQ(labeling.stats.min_j[k], expected.stats.min_j[k]);
+      ASSERT_EQ(labeling.stats.max_i[k], expected.stats.max_i[k]);
+      ASSERT_EQ(labeling.stats.max_j[k], expected.stats.max_j[k]);
+      ASSERT_EQ(labeling.stats.sum_ij[k], expected.stats.sum_ij[k]);
+    }
+  }
+}
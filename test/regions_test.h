@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2018 Tobias Heider <heidert@nm.ifi.lmu.de>
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v3 See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef BALKEN__REGIONS_TEST_H__INCLUDED
+#define BALKEN__REGIONS_TEST_H__INCLUDED
+
+#include <gtest/gtest.h>
+#include "TestBase.h"
+
+class RegionsTest : public ::testing::Test
+{
+public:
+  RegionsTest() { LOG_MESSAGE("Opening test suite: RegionsTest"); }
+
+  virtual ~RegionsTest() { LOG_MESSAGE("Closing test suite: RegionsTest"); }
+
+  virtual void SetUp() {}
+
+  virtual void TearDown() {}
+};
+
+#endif  // BALKEN__REGIONS_TEST_H__INCLUDED